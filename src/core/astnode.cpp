@@ -12,6 +12,7 @@
 #include "codedocument.h"
 #include "codedocument_p.h"
 #include "treesitter/node.h"
+#include "treesitter/tree_cursor.h"
 
 #include <QPlainTextEdit>
 
@@ -34,14 +35,59 @@ Core::AstNodeList AstNode::childrenNodes() const
 {
     QList<AstNode> children;
     if (auto n = node()) {
-        const auto childNodes = n->children();
-        for (const auto &node : childNodes) {
+        children.reserve(n->childCount());
+        for (const auto &node : treesitter::NodeRange::children(*n)) {
             children.append(AstNode(node, document()));
         }
     }
     return children;
 }
 
+AstNode AstNode::firstChild() const
+{
+    if (auto n = node()) {
+        auto children = treesitter::NodeRange::children(*n);
+        if (auto it = children.begin(); it != children.end())
+            return AstNode(*it, document());
+    }
+    return {};
+}
+
+AstNode AstNode::nextSibling() const
+{
+    if (auto n = node()) {
+        if (const auto sibling = n->nextSibling(); !sibling.isNull())
+            return AstNode(sibling, document());
+    }
+    return {};
+}
+
+AstNode AstNode::previousSibling() const
+{
+    if (auto n = node()) {
+        if (const auto sibling = n->previousSibling(); !sibling.isNull())
+            return AstNode(sibling, document());
+    }
+    return {};
+}
+
+AstNode AstNode::nextNode(const AstNode &root) const
+{
+    if (auto child = firstChild(); child.isValid())
+        return child;
+
+    auto n = node();
+    if (!n)
+        return {};
+
+    const auto rootNode = root.isValid() ? root.node() : std::nullopt;
+    for (auto current = *n; !current.isNull() && !(rootNode && current == *rootNode); current = current.parent()) {
+        if (const auto sibling = current.nextSibling(); !sibling.isNull())
+            return AstNode(sibling, document());
+    }
+    return {};
+}
+
 bool AstNode::isValid() const
 {
     return m_mark.isValid();
@@ -55,7 +101,16 @@ std::optional<treesitter::Node> AstNode::node() const
     }
 
     if (auto doc = document()) {
-        return doc->m_treeSitterHelper->syntaxTree()->rootNode().descendantForRange(startPos(), endPos());
+        auto node = doc->m_treeSitterHelper->syntaxTree()->rootNode().descendantForRange(startPos(), endPos());
+        // The smallest node covering the range is found, but its parents may cover the same range.
+        while (QLatin1String(node.rawType()) != m_type) {
+            const auto parent = node.parent();
+            if (parent.isNull() || parent.startPosition() != node.startPosition()
+                || parent.endPosition() != node.endPosition())
+                break;
+            node = parent;
+        }
+        return node;
     }
     return std::nullopt;
 }
@@ -36,6 +36,15 @@ public:
     Q_INVOKABLE QList<Core::AstNode> childrenNodes() const;
     Q_INVOKABLE bool isValid() const;
 
+    // Cursor-like navigation, to walk the tree one node at a time instead of listing all children of each node.
+    // They return an invalid node if there's no such node.
+    Q_INVOKABLE Core::AstNode firstChild() const;
+    Q_INVOKABLE Core::AstNode nextSibling() const;
+    Q_INVOKABLE Core::AstNode previousSibling() const;
+    // Next node in a pre-order walk of the tree (first child, next sibling, or next sibling of a parent), which is
+    // below `root`. Walks the whole document if `root` is invalid.
+    Q_INVOKABLE Core::AstNode nextNode(const Core::AstNode &root = {}) const;
+
     QString type() const;
     QString text() const;
     int startPos() const;
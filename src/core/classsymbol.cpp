@@ -10,6 +10,7 @@
 
 #include "classsymbol.h"
 #include "codedocument.h"
+#include "codedocument_p.h"
 #include "utils/log.h"
 
 namespace Core {
@@ -32,11 +33,16 @@ ClassSymbol::ClassSymbol(QObject *parent, const QueryMatch &match, Kind kind)
 
 QList<Symbol *> ClassSymbol::findMembers() const
 {
-    if (auto codeDocument = qobject_cast<Core::CodeDocument *>(parent())) {
+    if (auto codeDocument = document()) {
+        // Only create the Symbol objects of the members.
         QList<Symbol *> members;
-        for (auto &symbol : codeDocument->symbols()) {
-            if (m_range.contains(symbol->range()) && m_name != symbol->name())
-                members.append(symbol);
+        const auto &helper = codeDocument->helper();
+        const auto &symbolTable = helper->symbolTable();
+        for (qsizetype i = 0; i < symbolTable.size(); ++i) {
+            const auto &[start, end] = symbolTable.at(i).range;
+            const bool inClass = m_range.isValid() && start >= 0 && m_range.start() <= start && end <= m_range.end();
+            if (inClass && m_name != symbolTable.at(i).name)
+                members.append(helper->symbol(i));
         }
         return members;
     }
@@ -46,10 +52,13 @@ QList<Symbol *> ClassSymbol::findMembers() const
 
 const QList<Symbol *> &ClassSymbol::members() const
 {
-    if (!m_members.has_value()) {
-        m_members = {findMembers()};
+    const auto codeDocument = document();
+    const int version = codeDocument ? codeDocument->helper()->symbolsVersion() : -1;
+    if (version < 0 || version != m_membersVersion) {
+        m_members = findMembers();
+        m_membersVersion = version;
     }
-    return *m_members;
+    return m_members;
 }
 
 QString ClassSymbol::description() const
@@ -30,7 +30,10 @@ protected:
     ClassSymbol(QObject *parent, const QueryMatch &match, Kind kind);
 
     // mutable for lazy initialization
-    mutable std::optional<QList<Symbol *>> m_members;
+    // The members are owned by the document, and released with its symbol table (see
+    // TreeSitterHelper::releaseSymbols): they are found again once the table changed.
+    mutable QList<Symbol *> m_members;
+    mutable int m_membersVersion = -1;
 
 public:
     const QList<Symbol *> &members() const;
@@ -15,6 +15,7 @@
 #include "lsp_utils.h"
 #include "project.h"
 #include "querymatch.h"
+#include "querymatchiterator.h"
 #include "rangemark.h"
 #include "settings.h"
 #include "symbol.h"
@@ -22,6 +23,7 @@
 #include "utils/log.h"
 #include "utils/string_helper.h"
 
+#include <QDeadlineTimer>
 #include <QFile>
 #include <QJSEngine>
 #include <QMap>
@@ -32,6 +34,7 @@
 #include <algorithm>
 #include <kdalgorithms.h>
 #include <memory>
+#include <utility>
 
 namespace Core {
 
@@ -57,7 +60,7 @@ CodeDocument::CodeDocument(Type type, QObject *parent)
     : TextDocument(type, parent)
     , m_treeSitterHelper(std::make_unique<TreeSitterHelper>(this))
 {
-    connect(textEdit()->document(), &QTextDocument::contentsChange, this, &CodeDocument::changeContent);
+    connect(qTextDocument(), &QTextDocument::contentsChange, this, &CodeDocument::changeContent);
 }
 
 void CodeDocument::setLspClient(Lsp::Client *client)
@@ -79,12 +82,17 @@ bool CodeDocument::hasLspClient() const
  */
 Symbol *CodeDocument::currentSymbol(const std::function<bool(const Symbol &)> &filterFunc) const
 {
-    const int pos = textEdit()->textCursor().position();
-
-    const auto symbolList = symbols();
-    for (auto symbol : symbolList | std::views::reverse) {
-        if (symbol->range().contains(pos) && (!filterFunc || filterFunc(*symbol)))
-            return symbol;
+    const int pos = textCursor().position();
+
+    // Only create the Symbol objects of the symbols containing the cursor.
+    const auto &symbolTable = m_treeSitterHelper->symbolTable();
+    for (auto i = symbolTable.size() - 1; i >= 0; --i) {
+        const auto &[start, end] = symbolTable.at(i).range;
+        if (start <= pos && pos < end) {
+            auto symbol = m_treeSitterHelper->symbol(i);
+            if (!filterFunc || filterFunc(*symbol))
+                return symbol;
+        }
     }
     return {};
 }
@@ -161,14 +169,15 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Transforms, patterns);
  */
 const Core::Symbol *CodeDocument::symbolUnderCursor() const
 {
-    const auto containsCursor = [this](const Core::Symbol *symbol) {
-        return symbol->selectionRange().contains(textEdit()->textCursor().position());
+    const int pos = textCursor().position();
+    const auto containsCursor = [pos](const SymbolEntry &symbol) {
+        return symbol.selectionRange.first <= pos && pos < symbol.selectionRange.second;
     };
 
-    const auto symbols = this->symbols();
-    const auto symbolIter = kdalgorithms::find_if(symbols, containsCursor);
-    if (symbolIter) {
-        return *symbolIter;
+    const auto &symbolTable = m_treeSitterHelper->symbolTable();
+    const auto symbolIter = std::ranges::find_if(symbolTable, containsCursor);
+    if (symbolIter != symbolTable.cend()) {
+        return m_treeSitterHelper->symbol(std::distance(symbolTable.cbegin(), symbolIter));
     }
 
     return nullptr;
@@ -180,12 +189,12 @@ const Core::Symbol *CodeDocument::symbolUnderCursor() const
  * Returns information about the symbol at the current cursor position.
  * The result of this call is a plain string that may be formatted in Markdown.
  */
-QString CodeDocument::hover() const
+QString CodeDocument::hover()
 {
-    return hover(textEdit()->textCursor().position());
+    return hover(textCursor().position());
 }
 
-QString CodeDocument::hover(int position, std::function<void(const QString &)> asyncCallback /*  = {} */) const
+QString CodeDocument::hover(int position, std::function<void(const QString &)> asyncCallback /*  = {} */)
 {
     if (asyncCallback) {
         return hoverWithRange(position,
@@ -199,12 +208,13 @@ QString CodeDocument::hover(int position, std::function<void(const QString &)> a
 }
 
 std::pair<QString, std::optional<RangeMark>> CodeDocument::hoverWithRange(
-    int position, std::function<void(const QString &, std::optional<RangeMark>)> asyncCallback /*  = {} */) const
+    int position, std::function<void(const QString &, std::optional<RangeMark>)> asyncCallback /*  = {} */)
 {
     spdlog::debug("{}", FUNCTION_NAME);
 
     if (!checkClient())
         return {"", {}};
+    flushPendingLspChange();
 
     Lsp::HoverParams params;
     params.textDocument.uri = toUri();
@@ -258,13 +268,14 @@ std::pair<QString, std::optional<RangeMark>> CodeDocument::hoverWithRange(
     return {"", {}};
 }
 
-RangeMarkList CodeDocument::references(int position) const
+RangeMarkList CodeDocument::references(int position)
 {
     spdlog::debug("{}", FUNCTION_NAME);
 
     if (!checkClient()) {
         return {};
     }
+    flushPendingLspChange();
 
     Lsp::ReferenceParams params;
     params.textDocument.uri = toUri();
@@ -290,11 +301,12 @@ Document *CodeDocument::followSymbol()
     spdlog::debug("{}", FUNCTION_NAME);
     if (!checkClient())
         return {};
+    flushPendingLspChange();
 
     // Set the cursor position to the beginning of any selected text.
     // That way, calling followSymbol twice in a row causes Clangd
     // to switch between declaration and definition.
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     return followSymbol(cursor.selectionStart());
 }
 
@@ -304,7 +316,7 @@ Document *CodeDocument::followSymbol()
 // - Go to the definition, if the symbol under cursor is a declaration
 Document *CodeDocument::followSymbol(int pos)
 {
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(pos);
 
     Lsp::DeclarationParams params;
@@ -364,21 +376,19 @@ Document *CodeDocument::switchDeclarationDefinition()
     spdlog::debug("{}", FUNCTION_NAME);
     if (!checkClient())
         return {};
-
-    auto cursor = textEdit()->textCursor();
-    auto symbolList = symbols();
-
-    auto currentFunction = kdalgorithms::find_if(symbolList, [&cursor](const auto &symbol) {
-        auto isInRange = symbol->range().contains(cursor.position());
-        return isInRange && symbol->isFunction();
-    });
-
-    if (!currentFunction) {
-        spdlog::info("{}: Cursor is currently not within a function!", FUNCTION_NAME);
-        return nullptr;
+    flushPendingLspChange();
+
+    const int pos = textCursor().position();
+    const auto &symbolTable = m_treeSitterHelper->symbolTable();
+    for (qsizetype i = 0; i < symbolTable.size(); ++i) {
+        const auto &[start, end] = symbolTable.at(i).range;
+        if (start <= pos && pos < end && m_treeSitterHelper->symbol(i)->isFunction()) {
+            return followSymbol(symbolTable.at(i).selectionRange.first);
+        }
     }
 
-    return followSymbol((*currentFunction)->selectionRange().start());
+    spdlog::info("{}: Cursor is currently not within a function!", FUNCTION_NAME);
+    return nullptr;
 }
 
 /*!
@@ -466,7 +476,11 @@ int CodeDocument::selectSmallerSyntaxNode(int count /* = 1*/)
         if (matchesCurrentSelection) {
             ++count;
         }
-        smallerNodes = node->namedChildren();
+        // Only the first named child is used, no need to list all of them.
+        smallerNodes.clear();
+        if (node->namedChildCount() > 0) {
+            smallerNodes.push_back(node->namedChild(0));
+        }
     }
 
     if (node.has_value()) {
@@ -570,23 +584,21 @@ Symbol *CodeDocument::findSymbol(const QString &name, int options) const
 {
     LOG(LOG_ARG("text", name), options);
 
-    auto symbols = this->symbols();
+    const auto &symbolTable = m_treeSitterHelper->symbolTable();
     const auto regexp =
         (options & FindRegexp) ? ::Utils::createRegularExpression(name, options) : QRegularExpression {};
-    auto byName = [name, options, regexp](Symbol *symbol) {
+    const auto caseSensitivity = (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    auto byName = [name, options, regexp, caseSensitivity](const SymbolEntry &symbol) {
         if (options & FindWholeWords)
-            return symbol->name().compare(name,
-                                          (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive)
-                == 0;
+            return symbol.name.compare(name, caseSensitivity) == 0;
         else if (options & FindRegexp)
-            return regexp.match(symbol->name()).hasMatch();
+            return regexp.match(symbol.name).hasMatch();
         else
-            return symbol->name().endsWith(name,
-                                           (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive);
+            return symbol.name.endsWith(name, caseSensitivity);
     };
-    auto it = std::ranges::find_if(symbols, byName);
-    if (it != symbols.end())
-        return *it;
+    auto it = std::ranges::find_if(symbolTable, byName);
+    if (it != symbolTable.cend())
+        return m_treeSitterHelper->symbol(std::distance(symbolTable.cbegin(), it));
     return nullptr;
 }
 
@@ -598,7 +610,7 @@ void CodeDocument::didOpen()
     Lsp::DidOpenTextDocumentParams params;
     params.textDocument.uri = toUri();
     params.textDocument.version = revision();
-    params.textDocument.text = textEdit()->toPlainText().toStdString();
+    params.textDocument.text = qTextDocument()->toPlainText().toStdString();
     params.textDocument.languageId = m_lspClient->languageId();
 
     m_lspClient->didOpen(std::move(params));
@@ -625,12 +637,40 @@ std::string CodeDocument::toUri() const
     return QUrl::fromLocalFile(fileName()).toString().toStdString();
 }
 
+void CodeDocument::parseInBackground()
+{
+    m_treeSitterHelper->parseInBackground();
+}
+
+bool CodeDocument::isParsingInBackground() const
+{
+    return m_treeSitterHelper->isParsingInBackground();
+}
+
+std::optional<treesitter::Tree> CodeDocument::syntaxTreeCopy()
+{
+    const auto &tree = m_treeSitterHelper->syntaxTree();
+    if (!tree) {
+        return {};
+    }
+    return tree->copy();
+}
+
+void CodeDocument::releaseSyntaxTree()
+{
+    if (m_treeSitterHelper->isParsingInBackground())
+        return;
+    m_treeSitterHelper->releaseTree();
+}
+
 std::unique_ptr<TreeSitterHelper> &CodeDocument::helper()
 {
     return m_treeSitterHelper;
 }
 
-std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query)
+std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                                       const treesitter::QueryCursor::Limits &limits,
+                                                                       const treesitter::Predicates::Parameters &parameters)
 {
     const auto &tree = m_treeSitterHelper->syntaxTree();
     if (!tree || !query) {
@@ -639,13 +679,58 @@ std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std
 
     treesitter::QueryCursor cursor;
     cursor.setProgressCallback(ScriptDialogItem::updateProgress);
-    cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text()));
+    cursor.setLimits(limits);
+    cursor.execute(query, tree->rootNode(),
+                   std::make_unique<treesitter::Predicates>(m_treeSitterHelper->text(), parameters));
     return cursor;
 }
 
-Core::QueryMatch CodeDocument::queryFirst(const std::shared_ptr<treesitter::Query> &query)
+treesitter::QueryCursor::Limits CodeDocument::queryLimits(const QVariantMap &options)
 {
-    auto cursor = createQueryCursor(query);
+    const auto matchLimit = DEFAULT_VALUE(int, TreeSitterQueryMatchLimit);
+    const auto timeout = DEFAULT_VALUE(int, TreeSitterQueryTimeout);
+    const auto maxMatches = DEFAULT_VALUE(int, TreeSitterQueryMaxMatches);
+    return {.matchLimit = static_cast<uint32_t>(std::max(0, options.value("matchLimit", matchLimit).toInt())),
+            .timeout = options.value("timeout", timeout).toInt(),
+            .maxMatches = options.value("maxMatches", maxMatches).toInt()};
+}
+
+static const char *truncationReason(treesitter::QueryCursor::Truncation truncation)
+{
+    switch (truncation) {
+    case treesitter::QueryCursor::Truncation::None:
+        break;
+    case treesitter::QueryCursor::Truncation::MatchLimit:
+        return "too many in-progress matches, some matches may be missing";
+    case treesitter::QueryCursor::Truncation::Timeout:
+        return "timeout";
+    case treesitter::QueryCursor::Truncation::MaxMatches:
+        return "maximum number of matches reached";
+    }
+    return "";
+}
+
+// Logs why a query stopped early, and tells the caller if it did.
+static void reportTruncation(const QString &function, treesitter::QueryCursor::Truncation truncation,
+                             bool *truncated)
+{
+    const bool isTruncated = truncation != treesitter::QueryCursor::Truncation::None;
+    if (isTruncated) {
+        spdlog::warn("{}: Query stopped early: {}", function, truncationReason(truncation));
+    }
+    if (truncated) {
+        *truncated = isTruncated;
+    }
+}
+
+Core::QueryMatch CodeDocument::queryFirst(const std::shared_ptr<treesitter::Query> &query,
+                                          const treesitter::QueryCursor::Limits &limits,
+                                          const treesitter::Predicates::Parameters &parameters, bool *truncated)
+{
+    if (truncated) {
+        *truncated = false;
+    }
+    auto cursor = createQueryCursor(query, limits, parameters);
     if (!cursor.has_value()) {
         return {};
     }
@@ -654,18 +739,25 @@ Core::QueryMatch CodeDocument::queryFirst(const std::shared_ptr<treesitter::Quer
     if (match.has_value()) {
         return QueryMatch(*this, match.value());
     } else {
+        reportTruncation(FUNCTION_NAME, cursor->truncation(), truncated);
         return QueryMatch();
     }
 }
 
-Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query> &query)
+Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query> &query,
+                                         const treesitter::QueryCursor::Limits &limits,
+                                         const treesitter::Predicates::Parameters &parameters, bool *truncated)
 {
-    auto cursor = createQueryCursor(query);
+    if (truncated) {
+        *truncated = false;
+    }
+    auto cursor = createQueryCursor(query, limits, parameters);
     if (!cursor.has_value()) {
         return {};
     }
 
     auto matches = cursor->allRemainingMatches();
+    reportTruncation(FUNCTION_NAME, cursor->truncation(), truncated);
 
     return kdalgorithms::transformed<Core::QueryMatchList>(matches, [this](const treesitter::QueryMatch &match) {
         return QueryMatch(*this, match);
@@ -673,49 +765,127 @@ Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query
 }
 
 /*!
- * \qmlmethod array<QueryMatch> CodeDocument::query(string query)
+ * \qmlmethod array<QueryMatch> CodeDocument::query(string query, object options = {})
  * Runs the given Tree-sitter `query` and returns the list of matches.
  *
  * The query is using [Tree-sitter
  * queries](https://tree-sitter.github.io/tree-sitter/using-parsers#pattern-matching-with-queries).
  *
+ * The `options` can limit the time spent in the query, overriding the `/treesitter/query` settings:
+ *
+ * - `matchLimit`: maximum number of in-progress matches, some matches may be missing if exceeded
+ * - `timeout`: maximum duration of the query, in milliseconds
+ * - `maxMatches`: maximum number of matches returned
+ *
+ * A value of 0 means no limit. A warning is logged if a limit was hit, use `queryIter` and its `truncated` property to
+ * know it from a script.
+ *
  * Also see: [Tree-sitter in Knut](../../getting-started/treesitter.md)
  */
-Core::QueryMatchList CodeDocument::query(const QString &query)
+Core::QueryMatchList CodeDocument::query(const QString &query, const QVariantMap &options)
 {
     LOG(LOG_ARG("query", query));
 
-    return this->query(m_treeSitterHelper->constructQuery(query));
+    return this->query(m_treeSitterHelper->constructQuery(query), queryLimits(options));
 }
 
 /*!
- * \qmlmethod QueryMatch CodeDocument::queryFirst(string query)
+ * \qmlmethod QueryMatch CodeDocument::queryFirst(string query, object options = {})
  * Runs the given Tree-sitter `query` and returns the first match.
  * If no match can be found an empty match will be returned.
  *
  * This can be a lot faster than `query` if you only need the first match.
  *
+ * The `options` are the same as for `query`.
+ *
  * The query is using [Tree-sitter
  * queries](https://tree-sitter.github.io/tree-sitter/using-parsers#pattern-matching-with-queries).
  *
  * Also see: [Tree-sitter in Knut](../../getting-started/treesitter.md)
  Core::QueryMatchList CodeDocument::query(const QString &query)
  */
-Core::QueryMatch CodeDocument::queryFirst(const QString &query)
+Core::QueryMatch CodeDocument::queryFirst(const QString &query, const QVariantMap &options)
 {
     LOG(LOG_ARG("query", query));
 
-    return this->queryFirst(m_treeSitterHelper->constructQuery(query));
+    return this->queryFirst(m_treeSitterHelper->constructQuery(query), queryLimits(options));
+}
+
+/*!
+ * \qmlmethod iterable<QueryMatch> CodeDocument::queryIter(string query, int maxMatches = 0)
+ * Runs the given Tree-sitter `query`, and returns an iterable object returning the matches one by one.
+ *
+ * Contrary to `query`, the matches are only searched for when needed, so stopping early (or finding only a few
+ * matches) is a lot faster. At most `maxMatches` matches are returned, if `maxMatches` is positive. Otherwise the
+ * `/treesitter/query/max_matches` setting is used. The other limits of `query` are taken from the settings, the
+ * timeout starts when `queryIter` is called. The `truncated` property of the iterable is true if the iteration was
+ * stopped because of one of these limits.
+ *
+ * ```javascript
+ * for (const match of document.queryIter("(function_definition) @function")) {
+ *     if (match.get("function").text.includes("foo"))
+ *         break;
+ * }
+ * ```
+ *
+ * The iteration stops if the document is changed.
+ *
+ * \sa CodeDocument::query
+ */
+QJSValue CodeDocument::queryIter(const QString &query, int maxMatches)
+{
+    LOG(LOG_ARG("query", query), LOG_ARG("maxMatches", maxMatches));
+
+    auto engine = qjsEngine(this);
+    if (!engine) {
+        spdlog::error("{}: Can only be used from a script", FUNCTION_NAME);
+        return {};
+    }
+
+    // Wrap the iterator into a JavaScript iterator, so it can be used in a for...of loop.
+    // return() is called when the loop is exited early, so the query doesn't need to be kept alive.
+    auto wrap = engine->evaluate(R"js(
+        (function(iterator) {
+            return {
+                [Symbol.iterator]() { return this; },
+                get truncated() { return iterator.truncated; },
+                next() {
+                    const match = iterator.next();
+                    return iterator.atEnd ? { done: true, value: undefined } : { done: false, value: match };
+                },
+                return(value) {
+                    iterator.close();
+                    return { done: true, value: value };
+                }
+            };
+        })
+    )js");
+    return wrap.call({engine->newQObject(createQueryIterator(query, maxMatches).release())});
+}
+
+std::unique_ptr<QueryMatchIterator> CodeDocument::createQueryIterator(const QString &query, int maxMatches)
+{
+    auto limits = queryLimits();
+    if (maxMatches > 0) {
+        limits.maxMatches = maxMatches;
+    }
+    return std::unique_ptr<QueryMatchIterator>(
+        new QueryMatchIterator(this, createQueryCursor(m_treeSitterHelper->constructQuery(query), limits)));
 }
 
 /**
- * \qmlmethod array<QueryMatch> CodeDocument::queryInRange(RangeMark range, string query)
+ * \qmlmethod array<QueryMatch> CodeDocument::queryInRange(RangeMark range, string query, object options = {})
  *
  * Searches for the given `query`, but only in the provided `range`.
  *
+ * Only matches that are entirely inside the `range` are returned.
+ *
+ * The `options` are the same as for `query`.
+ *
  * \sa CodeDocument::query
  */
-Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, const QString &query)
+Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, const QString &query,
+                                                const QVariantMap &options)
 {
     LOG(LOG_ARG("range", range), LOG_ARG("query", query));
 
@@ -724,27 +894,79 @@ Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, co
         return {};
     }
 
-    const auto nodes = m_treeSitterHelper->nodesInRange(range);
+    return queryInRanges({range}, query, queryLimits(options));
+}
+
+QList<Core::QueryMatch> CodeDocument::queryInRanges(const Core::RangeMarkList &ranges, const QString &query,
+                                                    const treesitter::QueryCursor::Limits &limits,
+                                                    const treesitter::Predicates::Parameters &parameters,
+                                                    bool *truncated)
+{
+    if (truncated) {
+        *truncated = false;
+    }
 
-    if (nodes.isEmpty()) {
-        spdlog::warn("{}: No nodes in range", FUNCTION_NAME);
+    const auto &tree = m_treeSitterHelper->syntaxTree();
+    if (!tree) {
         return {};
     }
-    spdlog::debug("{}: Found {} nodes in range", FUNCTION_NAME, nodes.size());
 
     auto tsQuery = m_treeSitterHelper->constructQuery(query);
-    if (!tsQuery)
+    if (!tsQuery) {
         return {};
+    }
 
+    // The limits are for the whole call, and not for each execution of the cursor.
+    const QDeadlineTimer deadline =
+        limits.timeout > 0 ? QDeadlineTimer(limits.timeout) : QDeadlineTimer(QDeadlineTimer::Forever);
+    auto truncation = treesitter::QueryCursor::Truncation::None;
+
+    const auto &source = m_treeSitterHelper->text();
     treesitter::QueryCursor cursor;
     Core::QueryMatchList matches;
-    for (const treesitter::Node &node : nodes) {
-        cursor.execute(tsQuery, node, std::make_unique<treesitter::Predicates>(text()));
-        matches.append(kdalgorithms::transformed<QList<QueryMatch>>(cursor.allRemainingMatches(),
-                                                                    [this](const treesitter::QueryMatch &match) {
-                                                                        return QueryMatch(*this, match);
-                                                                    }));
+    for (const auto &range : ranges) {
+        if (!range.isValid() || range.document() != this) {
+            spdlog::warn("{}: Range is not valid", FUNCTION_NAME);
+            continue;
+        }
+
+        // Only run the query on the outermost nodes inside the range, so the matches (and not only their captures)
+        // are inside the range. The same cursor, query and text are used for all of them.
+        const auto nodes = m_treeSitterHelper->nodesInRange(range);
+        spdlog::debug("{}: Found {} nodes in range", FUNCTION_NAME, nodes.size());
+        for (const auto &node : nodes) {
+            if (deadline.hasExpired()) {
+                truncation = treesitter::QueryCursor::Truncation::Timeout;
+                break;
+            }
+            auto nodeLimits = limits;
+            if (limits.timeout > 0) {
+                nodeLimits.timeout = static_cast<int>(std::max<qint64>(1, deadline.remainingTime()));
+            }
+            // Counted over all nodes below.
+            nodeLimits.maxMatches = 0;
+            cursor.setLimits(nodeLimits);
+            cursor.execute(tsQuery, node, std::make_unique<treesitter::Predicates>(source, parameters));
+            for (auto match = cursor.nextMatch(); match.has_value(); match = cursor.nextMatch()) {
+                // Same as QueryCursor, only truncated if there actually is another match.
+                if (limits.maxMatches > 0 && matches.size() >= limits.maxMatches) {
+                    truncation = treesitter::QueryCursor::Truncation::MaxMatches;
+                    break;
+                }
+                matches.emplace_back(*this, match.value());
+            }
+            if (truncation == treesitter::QueryCursor::Truncation::None) {
+                truncation = cursor.truncation();
+            }
+            if (truncation != treesitter::QueryCursor::Truncation::None) {
+                break;
+            }
+        }
+        if (truncation != treesitter::QueryCursor::Truncation::None) {
+            break;
+        }
     }
+    reportTruncation(FUNCTION_NAME, truncation, truncated);
     return matches;
 }
 
@@ -755,7 +977,6 @@ int CodeDocument::revision() const
 
 bool CodeDocument::checkClient() const
 {
-    Q_ASSERT(textEdit());
     if (!Settings::instance()->hasLsp())
         return false;
     if (!client()) {
@@ -765,6 +986,12 @@ bool CodeDocument::checkClient() const
     return true;
 }
 
+void CodeDocument::flushPendingLspChange()
+{
+    if (std::exchange(m_lspChangePending, false) && checkClient())
+        sendContentLsp();
+}
+
 void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdded)
 {
     Q_UNUSED(position)
@@ -772,7 +999,7 @@ void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdd
     Q_UNUSED(charsAdded)
 
     // TODO: Keep copy of previous string around, so we can find the oldEndPosition.
-    // const auto document = textEdit()->document();
+    // const auto document = qTextDocument();
     // const auto startblock = document->findBlock(position);
     // spdlog::warn("{} - start point: {}, {}", FUNCTION_NAME, startblock.blockNumber(), position -
     // startblock.position());
@@ -785,10 +1012,19 @@ void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdd
     // const auto plain = document->toPlainText();
     // spdlog::warn("{} - added: {}", FUNCTION_NAME, plain.sliced(position, charsAdded));
 
-    if (!checkClient()) {
+    // The entire document is sent, so during a batch it's only sent once: when the batch ends, or before the next
+    // request to the language server.
+    if (isInBatch()) {
+        m_lspChangePending = true;
         return;
     }
 
+    if (checkClient())
+        sendContentLsp();
+}
+
+void CodeDocument::sendContentLsp()
+{
     if (client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Full)
         || client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental)) {
         // TODO: We currently always send the entire document to the Language server, even
@@ -823,15 +1059,10 @@ void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdd
 
 void CodeDocument::changeContentTreeSitter(int position, int charsRemoved, int charsAdded)
 {
-    Q_UNUSED(position)
-    Q_UNUSED(charsRemoved)
-    Q_UNUSED(charsAdded)
-
     // Note: This invalidates all existing treesitter::Node instances of this tree!
     // Only use treesitter nodes as long as you're certain the document isn't edited!
-    // TODO: If we keep the old string around, we could implement incremental parsing here.
-    // If TreeSitter parsing ever becomes a performance bottleneck, this would be where to fix it.
-    m_treeSitterHelper->clear();
+    // The tree itself is kept and edited, so the next parse can be done incrementally.
+    m_treeSitterHelper->edit(position, charsRemoved, charsAdded);
 }
 
 void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
@@ -845,6 +1076,7 @@ void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
     // As we're not quite done with updating the text at this point, we cannot redraw yet!
     LoggerDisabler disabler;
 
+    changeIncludedRanges(position, charsRemoved, charsAdded);
     changeContentLsp(position, charsRemoved, charsAdded);
     changeContentTreeSitter(position, charsRemoved, charsAdded);
 }
@@ -864,4 +1096,18 @@ QList<treesitter::Range> CodeDocument::includedRanges() const
     return {};
 }
 
+void CodeDocument::changeIncludedRanges(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(position)
+    Q_UNUSED(charsRemoved)
+    Q_UNUSED(charsAdded)
+}
+
+void CodeDocument::batchFinished()
+{
+    // The syntax tree and the marks are still updated by each edit of the batch, as an edit only adjusts positions
+    // (the tree is parsed again once needed). The language server gets the whole document, so it's sent only once.
+    flushPendingLspChange();
+}
+
 } // namespace Core
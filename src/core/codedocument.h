@@ -16,8 +16,12 @@
 #include "symbol.h"
 #include "textdocument.h"
 #include "treesitter/parser.h"
+#include "treesitter/predicates.h"
 #include "treesitter/query.h"
+#include "treesitter/tree.h"
 
+#include <QJSValue>
+#include <QVariantMap>
 #include <functional>
 #include <memory>
 
@@ -34,6 +38,7 @@ class Query;
 namespace Core {
 
 class TreeSitterHelper;
+class QueryMatchIterator;
 struct RegexpTransform;
 class AstNode;
 
@@ -48,20 +53,40 @@ public:
 
     Q_INVOKABLE Core::Symbol *findSymbol(const QString &name, int options = NoFindFlags) const;
     Q_INVOKABLE Core::SymbolList symbols() const;
-    Q_INVOKABLE QString hover() const;
+    Q_INVOKABLE QString hover();
     Q_INVOKABLE const Core::Symbol *symbolUnderCursor() const;
 
-    Q_INVOKABLE Core::QueryMatchList query(const QString &query);
-    Q_INVOKABLE Core::QueryMatch queryFirst(const QString &query);
-    Q_INVOKABLE Core::QueryMatchList queryInRange(const Core::RangeMark &range, const QString &query);
+    Q_INVOKABLE Core::QueryMatchList query(const QString &query, const QVariantMap &options = {});
+    Q_INVOKABLE Core::QueryMatch queryFirst(const QString &query, const QVariantMap &options = {});
+    Q_INVOKABLE Core::QueryMatchList queryInRange(const Core::RangeMark &range, const QString &query,
+                                                  const QVariantMap &options = {});
+    Q_INVOKABLE QJSValue queryIter(const QString &query, int maxMatches = 0);
 
     // This overload exists for improved performance. It's not user-facing API.
     //
     // It turns out that constructing Query instances is relatively expensive.
     // Therefore it's better to construct them once and reuse them.
     // So allow this for outside users.
-    QList<Core::QueryMatch> query(const std::shared_ptr<treesitter::Query> &query);
-    Core::QueryMatch queryFirst(const std::shared_ptr<treesitter::Query> &query);
+    // Note: Queries passed as a string are also reused, via the treesitter::QueryCache.
+    // The `parameters` are bound to the "$name" arguments of the query predicates, see treesitter::Predicates.
+    // If `truncated` is set, it tells if the query stopped early because of one of the `limits`.
+    QList<Core::QueryMatch> query(const std::shared_ptr<treesitter::Query> &query,
+                                  const treesitter::QueryCursor::Limits &limits = {},
+                                  const treesitter::Predicates::Parameters &parameters = {}, bool *truncated = nullptr);
+    Core::QueryMatch queryFirst(const std::shared_ptr<treesitter::Query> &query,
+                                const treesitter::QueryCursor::Limits &limits = {},
+                                const treesitter::Predicates::Parameters &parameters = {}, bool *truncated = nullptr);
+    // Same as queryInRange, but runs the query in each of the ranges, which is faster than calling queryInRange
+    // repeatedly. Used by QueryMatch::queryIn. The limits apply to all ranges together.
+    QList<Core::QueryMatch> queryInRanges(const Core::RangeMarkList &ranges, const QString &query,
+                                          const treesitter::QueryCursor::Limits &limits = {},
+                                          const treesitter::Predicates::Parameters &parameters = {},
+                                          bool *truncated = nullptr);
+    // Limits of the queries run by scripts: the defaults come from the settings, and can be overridden by the
+    // `options` (see CodeDocument::query).
+    static treesitter::QueryCursor::Limits queryLimits(const QVariantMap &options = {});
+    // C++ API of queryIter. The iterator is at its end if the query can't be run.
+    std::unique_ptr<QueryMatchIterator> createQueryIterator(const QString &query, int maxMatches = 0);
 
     bool hasLspClient() const;
 
@@ -73,14 +98,25 @@ public:
     // As they rely on the clangd LSP, they are not reliable enough to use for scripting.
     Core::Document *switchDeclarationDefinition();
     Core::Document *followSymbol();
-    Core::RangeMarkList references(int position) const;
+    Core::RangeMarkList references(int position);
 
-    QString hover(int position, std::function<void(const QString &)> asyncCallback = {}) const;
+    QString hover(int position, std::function<void(const QString &)> asyncCallback = {});
 
     Q_INVOKABLE Core::AstNode astNodeAt(int pos);
 
     virtual QList<treesitter::Range> includedRanges() const;
 
+    // Parses the document on a worker thread, so opening a large document doesn't block the GUI. Large edits are
+    // then parsed in the background as well. Anything needing the syntax tree in the meantime (e.g. a script) waits
+    // for the parse to finish. syntaxTreeReady is emitted once the tree is available.
+    void parseInBackground();
+    bool isParsingInBackground() const;
+    // Copy of the syntax tree (parsed if needed), sharing its data with the tree of the document.
+    std::optional<treesitter::Tree> syntaxTreeCopy();
+    // Drops the syntax tree and everything computed from it (e.g. the symbols) to save memory, they are computed
+    // again once needed. Does nothing while the document is parsed in the background.
+    void releaseSyntaxTree();
+
 public slots:
     void selectSymbol(const QString &name, int options = NoFindFlags);
 
@@ -89,6 +125,9 @@ public slots:
     int selectNextSyntaxNode(int count = 1);
     int selectPreviousSyntaxNode(int count = 1);
 
+signals:
+    void syntaxTreeReady();
+
 protected:
     explicit CodeDocument(Type type, QObject *parent = nullptr);
 
@@ -102,29 +141,43 @@ protected:
 
     std::pair<QString, std::optional<RangeMark>>
     hoverWithRange(int position,
-                   std::function<void(const QString &, std::optional<RangeMark>)> asyncCallback = {}) const;
+                   std::function<void(const QString &, std::optional<RangeMark>)> asyncCallback = {});
 
     std::unique_ptr<TreeSitterHelper> &helper();
 
+    // Called on each change of the document, before the syntax tree is updated, so the included ranges can be
+    // updated as well.
+    virtual void changeIncludedRanges(int position, int charsRemoved, int charsAdded);
+
+    void batchFinished() override;
+
 private:
     bool checkClient() const;
+    // Sends the changes of the running batch, so a request to the language server is done on the current text.
+    void flushPendingLspChange();
     Document *followSymbol(int pos);
 
-    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query);
+    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                             const treesitter::QueryCursor::Limits &limits = {},
+                                                             const treesitter::Predicates::Parameters &parameters = {});
 
     void changeContent(int position, int charsRemoved, int charsAdded);
     void changeContentLsp(int position, int charsRemoved, int charsAdded);
+    void sendContentLsp();
     void changeContentTreeSitter(int position, int charsRemoved, int charsAdded);
 
     // Language Server
     QPointer<Lsp::Client> m_lspClient;
     int m_revision = 0;
+    bool m_lspChangePending = false;
 
     // TreeSitter
     friend TreeSitterHelper;
     std::unique_ptr<TreeSitterHelper> m_treeSitterHelper;
 
     friend class AstNode;
+    friend class ClassSymbol;
+    friend class QueryMatchIterator;
 };
 
 } // namespace Core
@@ -11,9 +11,20 @@
 #include "codedocument_p.h"
 #include "codedocument.h"
 #include "treesitter/languages.h"
+#include "treesitter/query_cache.h"
 #include "treesitter/tree_cursor.h"
 #include "utils/log.h"
 
+#include <QJSEngine>
+#include <QPlainTextEdit>
+#include <QPromise>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QThreadPool>
+#include <QtQml/private/qqmldata_p.h>
+#include <algorithm>
+#include <utility>
 #include <kdalgorithms.h>
 
 namespace Core {
@@ -26,34 +37,221 @@ TreeSitterHelper::TreeSitterHelper(CodeDocument *document)
 {
 }
 
+void TreeSitterHelper::setSymbolQueries(QList<SymbolQuery> queries)
+{
+    // Concatenate all queries, and remember where each of them starts (in bytes, like
+    // treesitter::Query::Pattern::utf8_start_byte), to find out which one a pattern belongs to.
+    QString combinedQuery;
+    QList<uint32_t> startBytes;
+    uint32_t startByte = 0;
+    for (const auto &query : std::as_const(queries)) {
+        startBytes.push_back(startByte);
+        combinedQuery += query.query + u'\n';
+        startByte += static_cast<uint32_t>(query.query.toUtf8().size() + 1);
+    }
+
+    querySymbols = [this, combinedQuery, startBytes,
+                    queries = std::move(queries)](CodeDocument *const document) -> QList<SymbolEntry> {
+        const auto tsQuery = constructQuery(combinedQuery);
+        if (!tsQuery) {
+            return {};
+        }
+
+        const auto patternQueries = kdalgorithms::transformed(tsQuery->patterns(), [&startBytes](const auto &pattern) {
+            const auto it = std::ranges::upper_bound(startBytes, pattern.utf8_start_byte);
+            return std::distance(startBytes.cbegin(), it) - 1;
+        });
+
+        // The symbols are queried again after each edit, only look for them again where the document changed.
+        const auto matches = cachedQuery(tsQuery);
+        const auto &text = this->text();
+        QList<SymbolEntry> symbols;
+        symbols.reserve(matches.size());
+        for (const auto &[match, patternIndex] : matches) {
+            const auto &query = queries.at(patternQueries.at(patternIndex));
+            if (const auto kind = query.symbolKind(match)) {
+                const auto name = match.span("name");
+                symbols.push_back({.name = name.first >= 0 ? text.sliced(name.first, name.second - name.first) : "",
+                                   .kind = *kind,
+                                   .range = match.span("range"),
+                                   .selectionRange = match.span("selectionRange"),
+                                   .match = match});
+            }
+        }
+        return symbols;
+    };
+}
+
 void TreeSitterHelper::clear()
 {
     m_tree = {};
-    m_symbols.clear();
+    m_editedTree = {};
+    m_text.clear();
+    m_symbolTable.clear();
+    releaseSymbols();
+    m_queryResults.clear();
     m_flags &= ~HasSymbols;
 }
 
-treesitter::Parser &TreeSitterHelper::parser()
+void TreeSitterHelper::releaseTree()
 {
-    if (!m_parser) {
-        m_parser = treesitter::Parser(treesitter::Parser::getLanguage(m_document->type()));
+    // Users of the current tree (e.g. a QueryMatchIterator) can't use it anymore.
+    ++m_version;
+    clear();
+}
+
+// Same conversion as QTextDocument::toPlainText, so the text kept up to date by edit() is the one of a full parse.
+static QString toPlainText(QString text)
+{
+    for (auto &c : text) {
+        switch (c.unicode()) {
+        case 0xfdd0: // QTextBeginningOfFrame
+        case 0xfdd1: // QTextEndOfFrame
+        case QChar::ParagraphSeparator:
+        case QChar::LineSeparator:
+            c = u'\n';
+            break;
+        case QChar::Nbsp:
+            c = u' ';
+            break;
+        default:
+            break;
+        }
+    }
+    return text;
+}
+
+static treesitter::Point pointAt(const QTextDocument *document, int position)
+{
+    // Same as in CppDocument::includedRanges, columns are counted in bytes, not characters.
+    const auto block = document->findBlock(position);
+    return {.row = static_cast<uint32_t>(block.blockNumber()),
+            .column = static_cast<uint32_t>((position - block.position()) * sizeof(QChar))};
+}
+
+static treesitter::Point pointAfter(treesitter::Point start, QStringView text)
+{
+    const auto lines = text.count(u'\n');
+    if (lines == 0) {
+        start.column += static_cast<uint32_t>(text.size() * sizeof(QChar));
+        return start;
+    }
+    return {.row = start.row + static_cast<uint32_t>(lines),
+            .column = static_cast<uint32_t>((text.size() - text.lastIndexOf(u'\n') - 1) * sizeof(QChar))};
+}
+
+int TreeSitterHelper::version() const
+{
+    return m_version;
+}
+
+int TreeSitterHelper::symbolsVersion() const
+{
+    return m_symbolsVersion;
+}
+
+void TreeSitterHelper::edit(int position, int charsRemoved, int charsAdded)
+{
+    if (!m_tree && !m_editedTree) {
+        ++m_version;
+        releaseSymbols();
+        m_queryResults.clear();
+        m_flags &= ~HasSymbols;
+        return;
+    }
+
+    const auto document = m_document->qTextDocument();
+    // QTextDocument sometimes reports changes that include the final paragraph separator
+    // (e.g. when the whole text is replaced), which don't match the text we know about.
+    // Fall back to a full parse in this case.
+    if (position < 0 || position + charsRemoved > m_text.size()
+        || m_text.size() - charsRemoved + charsAdded != document->characterCount() - 1) {
+        ++m_version;
+        clear();
+        if (m_parseInBackground && charsAdded >= BackgroundParseThreshold) {
+            parseInBackground();
+        }
+        return;
+    }
+
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + charsAdded, QTextCursor::KeepAnchor);
+    const auto addedText = toPlainText(cursor.selectedText());
+
+    // Also done for format changes: the RangeMarks of the cached matches collapse anyway.
+    updateDirtyRanges(position, charsRemoved, charsAdded);
+
+    const auto removedText = QStringView(m_text).sliced(position, charsRemoved);
+    if (removedText == addedText) {
+        // Format changes (e.g. from a syntax highlighter) are also reported, even though the text didn't change.
+        return;
+    }
+
+    ++m_version;
+    releaseSymbols();
+    m_flags &= ~HasSymbols;
+
+    if (m_tree) {
+        m_editedTree = std::move(m_tree);
+        m_tree = {};
     }
 
-    // Regarding const-ness:
-    // The TreeSitter parser can't change anything about the documents contents.
-    // Therefore it is okay to be returned by non-const reference, even in a const function.
-    return const_cast<treesitter::Parser &>(*m_parser);
+    const auto startPoint = pointAt(document, position);
+    const treesitter::InputEdit edit {
+        .start_byte = static_cast<uint32_t>(position * sizeof(QChar)),
+        .old_end_byte = static_cast<uint32_t>((position + charsRemoved) * sizeof(QChar)),
+        .new_end_byte = static_cast<uint32_t>((position + charsAdded) * sizeof(QChar)),
+        .start_point = startPoint,
+        .old_end_point = pointAfter(startPoint, removedText),
+        .new_end_point = pointAt(document, position + charsAdded),
+    };
+    m_editedTree->edit(edit);
+    m_text.replace(position, charsRemoved, addedText);
+
+    if (m_parseInBackground && charsAdded >= BackgroundParseThreshold) {
+        parseInBackground();
+    }
+}
+
+void TreeSitterHelper::updateText()
+{
+    // The text of the edited tree is kept up to date by edit(), only get the whole text for a full parse.
+    if (!m_editedTree || m_text.size() != m_document->qTextDocument()->characterCount() - 1) {
+        m_editedTree = {};
+        m_text = m_document->text();
+    }
 }
 
 std::optional<treesitter::Tree> &TreeSitterHelper::syntaxTree()
 {
+    if (!m_tree && m_backgroundParse.isValid()) {
+        // Scripts expect the tree to be available right away: wait for the background parse, instead of parsing
+        // the same text a second time.
+        m_backgroundParse.waitForFinished();
+        adoptBackgroundParse(false);
+    }
+
     if (!m_tree) {
-        auto &parser = this->parser();
-        if (!parser.setIncludedRanges(m_document->includedRanges())) {
+        treesitter::PooledParser parser(m_document->type());
+        if (!parser->setIncludedRanges(m_document->includedRanges())) {
             spdlog::warn("{}: Unable to set the included ranges on the treesitter parser!", FUNCTION_NAME);
-            parser.setIncludedRanges({});
+            parser->setIncludedRanges({});
+        }
+        updateText();
+        // Passing the edited tree allows TreeSitter to reuse all unchanged parts of it.
+        m_tree = parser->parseString(m_text, m_editedTree ? &m_editedTree.value() : nullptr);
+        if (m_tree && m_editedTree) {
+            // The edits are already in the dirty ranges, add the parts whose structure changed because of them.
+            const auto changedRanges = m_editedTree->changedRanges(*m_tree);
+            for (const auto &range : changedRanges) {
+                addDirtyRange(static_cast<int>(range.start_byte / sizeof(QChar)),
+                              static_cast<int>(range.end_byte / sizeof(QChar)));
+            }
+        } else {
+            m_queryResults.clear();
         }
-        m_tree = parser.parseString(m_document->text());
+        m_editedTree = {};
         if (!m_tree) {
             spdlog::warn("{}: Failed to parse document {}!", FUNCTION_NAME, m_document->fileName());
         }
@@ -61,11 +259,101 @@ std::optional<treesitter::Tree> &TreeSitterHelper::syntaxTree()
     return m_tree;
 }
 
+void TreeSitterHelper::parseInBackground()
+{
+    m_parseInBackground = true;
+    // A running parse is started again once finished, if the document changed in the meantime.
+    if (m_tree || m_backgroundParse.isValid()) {
+        return;
+    }
+
+    updateText();
+    auto parse = std::make_shared<BackgroundParse>();
+    parse->version = m_version;
+    // The text is implicitly shared, it is copied by the next edit.
+    parse->text = m_text;
+    parse->includedRanges = m_document->includedRanges();
+    if (m_editedTree) {
+        parse->oldTree = m_editedTree->copy();
+    }
+
+    // The worker thread borrows a parser from its own pool, parsers can't be shared with the GUI thread.
+    auto promise = std::make_shared<QPromise<std::shared_ptr<BackgroundParse>>>();
+    m_backgroundParse = promise->future();
+    promise->start();
+    QThreadPool::globalInstance()->start(
+        [promise, parse, type = m_document->type()]() {
+            treesitter::PooledParser parser(type);
+            if (!parser->setIncludedRanges(parse->includedRanges)) {
+                parser->setIncludedRanges({});
+            }
+            parse->tree = parser->parseString(parse->text, parse->oldTree ? &parse->oldTree.value() : nullptr);
+            if (parse->tree && parse->oldTree) {
+                parse->changedRanges = parse->oldTree->changedRanges(*parse->tree);
+            }
+            promise->addResult(parse);
+            promise->finish();
+        });
+
+    // Runs in the GUI thread, and not at all if the document is deleted before.
+    m_backgroundParse.then(m_document, [this](std::shared_ptr<BackgroundParse>) {
+        adoptBackgroundParse(true);
+    });
+}
+
+bool TreeSitterHelper::isParsingInBackground() const
+{
+    return m_backgroundParse.isValid();
+}
+
+void TreeSitterHelper::adoptBackgroundParse(bool restartIfOutdated)
+{
+    // Already done by syntaxTree, when waiting for the parse to finish.
+    if (!m_backgroundParse.isValid() || !m_backgroundParse.isFinished()) {
+        return;
+    }
+    const auto parse = m_backgroundParse.result();
+    m_backgroundParse = {};
+
+    if (!m_tree) {
+        if (parse->version != m_version) {
+            if (restartIfOutdated) {
+                parseInBackground();
+                return;
+            }
+        } else if (parse->tree) {
+            // Nothing changed since the parse started, same as parsing in syntaxTree.
+            if (parse->oldTree) {
+                for (const auto &range : std::as_const(parse->changedRanges)) {
+                    addDirtyRange(static_cast<int>(range.start_byte / sizeof(QChar)),
+                                  static_cast<int>(range.end_byte / sizeof(QChar)));
+                }
+            } else {
+                m_queryResults.clear();
+            }
+            m_tree = std::move(parse->tree);
+            m_editedTree = {};
+        } else {
+            spdlog::warn("{}: Failed to parse document {}!", FUNCTION_NAME, m_document->fileName());
+        }
+    }
+
+    // Queued, as syntaxTree may be in the middle of something when it waits for the parse.
+    QMetaObject::invokeMethod(m_document, &CodeDocument::syntaxTreeReady, Qt::QueuedConnection);
+}
+
+const QString &TreeSitterHelper::text()
+{
+    syntaxTree();
+    return m_text;
+}
+
 std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QString &query)
 {
     std::shared_ptr<treesitter::Query> tsQuery;
     try {
-        tsQuery = std::make_shared<treesitter::Query>(parser().language(), query);
+        // Compiled queries are shared between all documents of the same language.
+        tsQuery = treesitter::QueryCache::instance().query(treesitter::Parser::getLanguage(m_document->type()), query);
     } catch (treesitter::Query::Error &error) {
         spdlog::error("{}: Failed to parse query `{}` error: {} at: {}", FUNCTION_NAME, query, error.description,
                       error.utf8_offset);
@@ -74,10 +362,148 @@ std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QStrin
     return tsQuery;
 }
 
+static bool matchTouches(const QueryMatch &match, std::pair<int, int> range)
+{
+    const auto [start, end] = match.span();
+    return start <= range.second && range.first <= end;
+}
+
+static void sortByPosition(QList<CachedQueryMatch> &matches)
+{
+    std::ranges::stable_sort(matches, [](const CachedQueryMatch &left, const CachedQueryMatch &right) {
+        const auto leftSpan = left.match.span();
+        const auto rightSpan = right.match.span();
+        if (leftSpan.first != rightSpan.first) {
+            return leftSpan.first < rightSpan.first;
+        }
+        if (leftSpan.second != rightSpan.second) {
+            return leftSpan.second > rightSpan.second;
+        }
+        // Matches queried again after an edit are added at the end: the pattern keeps the order the same as when
+        // querying the whole document (e.g. for the symbols, see TreeSitterHelper::symbolTable).
+        return left.patternIndex < right.patternIndex;
+    });
+}
+
+QList<CachedQueryMatch> TreeSitterHelper::cachedQuery(const std::shared_ptr<treesitter::Query> &query)
+{
+    const auto &tree = syntaxTree();
+    if (!tree || !query) {
+        return {};
+    }
+
+    auto it = std::ranges::find_if(m_queryResults, [&query](const QueryResult &result) {
+        return result.query == query;
+    });
+    if (it != m_queryResults.end()) {
+        m_queryResults.move(std::distance(m_queryResults.begin(), it), 0);
+        updateQueryResult(m_queryResults.first());
+        return m_queryResults.constFirst().matches;
+    }
+
+    QueryResult result {.query = query, .matches = {}, .dirtyRanges = {}};
+    treesitter::QueryCursor cursor;
+    cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(m_text));
+    for (auto match = cursor.nextMatch(); match.has_value(); match = cursor.nextMatch()) {
+        QueryMatch queryMatch(*m_document, match.value());
+        if (!queryMatch.isEmpty()) {
+            result.matches.push_back({std::move(queryMatch), match->patternIndex()});
+        }
+    }
+    sortByPosition(result.matches);
+
+    m_queryResults.prepend(std::move(result));
+    if (m_queryResults.size() > MaxQueryResults) {
+        m_queryResults.removeLast();
+    }
+    return m_queryResults.constFirst().matches;
+}
+
+void TreeSitterHelper::addDirtyRange(int start, int end)
+{
+    for (auto &result : m_queryResults) {
+        result.dirtyRanges.push_back({start, end});
+    }
+}
+
+void TreeSitterHelper::updateDirtyRanges(int position, int charsRemoved, int charsAdded)
+{
+    const auto delta = charsAdded - charsRemoved;
+    for (auto &result : m_queryResults) {
+        for (auto &[start, end] : result.dirtyRanges) {
+            if (end < position) {
+                continue;
+            }
+            if (start > position + charsRemoved) {
+                start += delta;
+                end += delta;
+                continue;
+            }
+            // The edit overlaps the range, extend it to cover the edit
+            start = std::min(start, position);
+            end = std::max(end < position + charsRemoved ? position : end + delta, position + charsAdded);
+        }
+        result.dirtyRanges.push_back({position, position + charsAdded});
+    }
+}
+
+void TreeSitterHelper::updateQueryResult(QueryResult &result)
+{
+    if (result.dirtyRanges.isEmpty()) {
+        return;
+    }
+
+    // Merge the ranges, so each part of the document is only queried once.
+    auto ranges = std::exchange(result.dirtyRanges, {});
+    std::ranges::sort(ranges);
+    QList<std::pair<int, int>> mergedRanges;
+    for (const auto &range : std::as_const(ranges)) {
+        if (!mergedRanges.isEmpty() && range.first <= mergedRanges.constLast().second) {
+            mergedRanges.last().second = std::max(mergedRanges.constLast().second, range.second);
+        } else {
+            mergedRanges.push_back(range);
+        }
+    }
+
+    const auto &tree = syntaxTree();
+    treesitter::QueryCursor cursor;
+    for (const auto &range : std::as_const(mergedRanges)) {
+        // Drop the matches touching the range, they may have changed. They have to be found again, so the part of
+        // the document queried again must include them.
+        auto [start, end] = range;
+        QList<CachedQueryMatch> matches;
+        matches.reserve(result.matches.size());
+        for (auto &cachedMatch : result.matches) {
+            if (matchTouches(cachedMatch.match, range)) {
+                const auto span = cachedMatch.match.span();
+                start = std::min(start, span.first);
+                end = std::max(end, span.second);
+            } else {
+                matches.push_back(std::move(cachedMatch));
+            }
+        }
+
+        // TreeSitter doesn't look into the nodes outside of the queried range, so query the whole node covering the
+        // range: all nodes of the matches inside of it are visited.
+        const auto node = nodeCoveringRange(start, end);
+        cursor.setRange(node.startPosition(), node.endPosition());
+        cursor.execute(result.query, tree->rootNode(), std::make_unique<treesitter::Predicates>(m_text));
+        for (auto match = cursor.nextMatch(); match.has_value(); match = cursor.nextMatch()) {
+            QueryMatch queryMatch(*m_document, match.value());
+            // The other matches in the node didn't change, and are already in the list.
+            if (!queryMatch.isEmpty() && matchTouches(queryMatch, range)) {
+                matches.push_back({std::move(queryMatch), match->patternIndex()});
+            }
+        }
+        result.matches = std::move(matches);
+    }
+    sortByPosition(result.matches);
+}
+
 // `nodesInRange` returns only the outermost nodes that fit entirely in the given range.
 // The subsequent children of these outermost nodes are *not* returned, even though
 // they are also technically in the range!
-// This is used by queryInRange to find on which nodes to run the query on.
+// The nodes are returned in document order.
 QList<treesitter::Node> TreeSitterHelper::nodesInRange(const RangeMark &range)
 {
     enum RangeComparison { Overlaps, Contains, Disjoint };
@@ -88,10 +514,6 @@ QList<treesitter::Node> TreeSitterHelper::nodesInRange(const RangeMark &range)
         return {};
     }
 
-    QList<treesitter::Node> nodesToVisit;
-    QList<treesitter::Node> nodesInRange;
-    nodesToVisit.emplace_back(tree->rootNode());
-
     auto compareToRange = [&range](const treesitter::Node &node) {
         if (range.contains(node.startPosition()) && range.contains(node.endPosition() - 1))
             return RangeComparison::Contains;
@@ -101,21 +523,30 @@ QList<treesitter::Node> TreeSitterHelper::nodesInRange(const RangeMark &range)
         return RangeComparison::Disjoint;
     };
 
-    // Note: This could be improved performance-wise using the first_child_for_byte
-    // functions on either TSNode, or TSTreeCursor.
-    // However, these functions aren't currently wrapped and would make the search a bit more complex.
-    while (!nodesToVisit.isEmpty()) {
-        auto node = nodesToVisit.takeLast();
-        switch (compareToRange(node)) {
-        case RangeComparison::Contains:
+    QList<treesitter::Node> nodesInRange;
+    treesitter::TreeCursor cursor(tree->rootNode());
+
+    bool hasNode = true;
+    while (hasNode) {
+        const auto node = cursor.currentNode();
+        const auto comparison = compareToRange(node);
+
+        // Skip all children that end before the range, instead of visiting each of them.
+        if (comparison == RangeComparison::Overlaps && cursor.gotoFirstChildForPosition(range.start())) {
+            continue;
+        }
+
+        if (comparison == RangeComparison::Contains) {
             nodesInRange.emplace_back(node);
-            break;
-        case RangeComparison::Overlaps:
-            nodesToVisit.append(node.children());
-            break;
-        default:
+        } else if (comparison == RangeComparison::Disjoint && static_cast<int>(node.startPosition()) > range.end()) {
+            // All remaining nodes are after the range.
             break;
         }
+
+        hasNode = cursor.gotoNextSibling();
+        while (!hasNode && cursor.gotoParent()) {
+            hasNode = cursor.gotoNextSibling();
+        }
     }
 
     return nodesInRange;
@@ -146,41 +577,97 @@ treesitter::Node TreeSitterHelper::nodeCoveringRange(int start, int end)
 
 void TreeSitterHelper::assignSymbolContexts()
 {
-    auto contextForSymbol = [this](Symbol *symbol) {
-        auto surroundsSymbol = [&symbol](const Symbol *otherSymbol) {
-            return symbol != otherSymbol && otherSymbol->range().contains(symbol->range());
-        };
-        auto surroundingSymbols = kdalgorithms::filtered(m_symbols, surroundsSymbol);
-
-        kdalgorithms::sort_by(
-            surroundingSymbols,
-            [](const auto &symbol) {
-                return symbol->range().length();
-            },
-            kdalgorithms::descending);
-        return surroundingSymbols;
-    };
+    // The symbols are sorted by start position (outermost first), and come from the syntax tree, so their ranges
+    // are either nested or disjoint. Keep a stack of the symbols surrounding the current one: everything on the
+    // stack that ends before the current symbol doesn't surround it (nor any following symbol).
+    QList<qsizetype> stack;
+    // Whether one of the surrounding symbols is a class.
+    QList<bool> inClass(m_symbolTable.size(), false);
+    for (qsizetype i = 0; i < m_symbolTable.size(); ++i) {
+        auto &symbol = m_symbolTable[i];
+        while (!stack.isEmpty() && m_symbolTable.at(stack.constLast()).range.second < symbol.range.second) {
+            stack.removeLast();
+        }
 
-    for (const auto &symbol : m_symbols | std::views::reverse) {
-        symbol->assignContext(contextForSymbol(symbol));
+        if (!stack.isEmpty()) {
+            // The surrounding symbol comes first, its name already contains the names of all the other ones.
+            const auto &parent = m_symbolTable.at(stack.constLast());
+            symbol.parent = stack.constLast();
+            symbol.name = parent.name + "::" + symbol.name;
+            inClass[i] = parent.kind == Symbol::Kind::Class || inClass.at(symbol.parent);
+            if (symbol.kind == Symbol::Kind::Function && inClass.at(i)) {
+                symbol.kind = Symbol::Kind::Method;
+            }
+        }
+        stack.push_back(i);
     }
 }
 
-const QList<Core::Symbol *> &TreeSitterHelper::symbols()
+const QList<SymbolEntry> &TreeSitterHelper::symbolTable()
 {
     if (m_flags & HasSymbols)
-        return m_symbols;
+        return m_symbolTable;
 
     m_flags |= HasSymbols;
 
-    m_symbols = querySymbols(m_document);
+    m_symbolTable = querySymbols(m_document);
 
-    kdalgorithms::sort_by(m_symbols, [](const auto &symbol) {
-        return symbol->range().start();
+    // Symbols starting at the same position are sorted outermost first, see assignSymbolContexts.
+    // The sort is stable: symbols with the same range keep the order of the matches, and so get the same context
+    // each time (e.g. a class and its declaration wrapped in a macro).
+    std::ranges::stable_sort(m_symbolTable, [](const SymbolEntry &left, const SymbolEntry &right) {
+        if (left.range.first != right.range.first) {
+            return left.range.first < right.range.first;
+        }
+        return left.range.second > right.range.second;
     });
 
     assignSymbolContexts();
 
+    releaseSymbols();
+    m_symbols = QList<Core::Symbol *>(m_symbolTable.size(), nullptr);
+
+    return m_symbolTable;
+}
+
+void TreeSitterHelper::releaseSymbols()
+{
+    // Scripts may still use the symbols of an outdated table: they are given to the JavaScript engine, which deletes
+    // them once they are not used anymore. The other ones were only used from C++, which doesn't keep them after the
+    // document changes.
+    for (auto symbol : std::as_const(m_symbols)) {
+        if (!symbol) {
+            continue;
+        }
+        if (QQmlData::get(symbol)) {
+            symbol->setParent(nullptr);
+            QJSEngine::setObjectOwnership(symbol, QJSEngine::JavaScriptOwnership);
+        } else {
+            symbol->deleteLater();
+        }
+    }
+    m_symbols.clear();
+    ++m_symbolsVersion;
+}
+
+Symbol *TreeSitterHelper::symbol(qsizetype index)
+{
+    symbolTable();
+    auto &symbol = m_symbols[index];
+    if (!symbol) {
+        const auto &entry = m_symbolTable.at(index);
+        symbol = Symbol::makeSymbol(m_document, entry.match, entry.kind);
+        symbol->m_name = entry.name;
+    }
+    return symbol;
+}
+
+const QList<Core::Symbol *> &TreeSitterHelper::symbols()
+{
+    const auto &table = symbolTable();
+    for (qsizetype i = 0; i < table.size(); ++i) {
+        symbol(i);
+    }
     return m_symbols;
 }
 
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "document.h"
+#include "querymatch.h"
 #include "rangemark.h"
 #include "symbol.h"
 #include "treesitter/node.h"
@@ -18,46 +19,151 @@
 #include "treesitter/query.h"
 #include "treesitter/tree.h"
 
+#include <QFuture>
 #include <QList>
+#include <optional>
 
 namespace Core {
 
 class CodeDocument;
 
+// Part of the symbol query of a language, see TreeSitterHelper::setSymbolQueries.
+struct SymbolQuery
+{
+    // May contain multiple patterns
+    QString query;
+    // Returns the kind of the symbol for a match of one of the patterns of query, may return nothing to skip the match.
+    std::function<std::optional<Symbol::Kind>(const QueryMatch &)> symbolKind;
+};
+
+// Symbol found by the symbol queries, see TreeSitterHelper::symbolTable.
+// The symbols of a document are kept in a flat table, the Symbol objects are only created when they are needed.
+struct SymbolEntry
+{
+    // Prefixed with the names of the surrounding symbols, e.g. "MyClass::method".
+    QString name;
+    Symbol::Kind kind;
+    // Positions when the symbols were found, the table is computed again after each edit.
+    std::pair<int, int> range;
+    std::pair<int, int> selectionRange;
+    // Index of the innermost symbol surrounding this one, or -1.
+    qsizetype parent = -1;
+    QueryMatch match;
+};
+
+// Match of a query cached by TreeSitterHelper::cachedQuery.
+struct CachedQueryMatch
+{
+    QueryMatch match;
+    uint32_t patternIndex;
+};
+
 class TreeSitterHelper
 {
 public:
-    using SymbolQueryFunction = std::function<QList<Core::Symbol *>(CodeDocument *const)>;
+    using SymbolQueryFunction = std::function<QList<SymbolEntry>(CodeDocument *const)>;
 
-    SymbolQueryFunction querySymbols = [](CodeDocument *const) -> QList<Core::Symbol *> {
+    SymbolQueryFunction querySymbols = [](CodeDocument *const) -> QList<SymbolEntry> {
         return {};
     };
 
     explicit TreeSitterHelper(CodeDocument *document);
 
-    void clear();
+    // Sets querySymbols to run all the queries as a single query, so the tree is only walked once to find all symbols.
+    void setSymbolQueries(QList<SymbolQuery> queries);
 
-    treesitter::Parser &parser();
+    void clear();
+    // Drops the syntax tree and everything found with it, they are computed again once needed.
+    void releaseTree();
+    // Drops the Symbol objects, once the symbol table is outdated.
+    void releaseSymbols();
+    // Incremented each time the Symbol objects are dropped, so the ones keeping some of them know when to let go.
+    int symbolsVersion() const;
+    // Keeps the current tree around for incremental parsing, see CodeDocument::changeContentTreeSitter.
+    void edit(int position, int charsRemoved, int charsAdded);
+    // Incremented each time the text changes, so users of the current tree know when it's outdated.
+    int version() const;
+
+    // Parses the document if needed. If a background parse is running, waits for it instead.
     std::optional<treesitter::Tree> &syntaxTree();
+    // Parses a snapshot of the text on a worker thread, see CodeDocument::parseInBackground.
+    void parseInBackground();
+    bool isParsingInBackground() const;
+    // Snapshot of the text the syntax tree was parsed from. It is only copied when the document is edited, so
+    // predicates can share it instead of copying the whole document for every query.
+    const QString &text();
 
     std::shared_ptr<treesitter::Query> constructQuery(const QString &query);
+    // Returns all the matches of the query, ordered by position.
+    // The matches are kept between calls. After an edit, the query is only run again around the parts of the
+    // document that changed, and the new matches replace the ones touching these parts.
+    // Only use it for queries whose patterns don't depend on anything outside of the matched nodes (e.g. patterns
+    // starting at the root node, or the #in_message_map? predicate). Matches without any capture are skipped.
+    QList<CachedQueryMatch> cachedQuery(const std::shared_ptr<treesitter::Query> &query);
     QList<treesitter::Node> nodesInRange(const RangeMark &range);
     treesitter::Node nodeCoveringRange(int start, int end);
 
+    // All symbols of the document, ordered by position (outermost first for symbols starting at the same position).
+    const QList<SymbolEntry> &symbolTable();
+    // Returns the Symbol object for an entry of the symbol table, creating it if needed.
+    Symbol *symbol(qsizetype index);
+    // Creates the Symbol objects of all the entries, prefer symbolTable when possible.
     const QList<Core::Symbol *> &symbols();
 
 private:
     void assignSymbolContexts();
 
+    // Result of a query for cachedQuery, with the parts of the document changed since the matches were found.
+    struct QueryResult
+    {
+        std::shared_ptr<treesitter::Query> query;
+        QList<CachedQueryMatch> matches;
+        // Character ranges, with the end included: a match touching a range has to be found again.
+        QList<std::pair<int, int>> dirtyRanges;
+    };
+    static constexpr int MaxQueryResults = 8;
+
+    // Everything needed to parse the text on another thread, and the result.
+    struct BackgroundParse
+    {
+        int version;
+        QString text;
+        QList<treesitter::Range> includedRanges;
+        std::optional<treesitter::Tree> oldTree;
+        std::optional<treesitter::Tree> tree;
+        QList<treesitter::Range> changedRanges;
+    };
+    // Edits adding at least this number of characters are parsed in the background, once enabled.
+    static constexpr int BackgroundParseThreshold = 100000;
+
+    void updateText();
+    void adoptBackgroundParse(bool restartIfOutdated);
+
+    void addDirtyRange(int start, int end);
+    void updateDirtyRanges(int position, int charsRemoved, int charsAdded);
+    void updateQueryResult(QueryResult &result);
+
     enum Flags {
         HasSymbols = 0x01,
     };
 
     CodeDocument *const m_document;
-    std::optional<treesitter::Parser> m_parser;
     std::optional<treesitter::Tree> m_tree;
+    // The last parsed tree, adjusted with all edits done since it was parsed.
+    std::optional<treesitter::Tree> m_editedTree;
+    // The text matching m_tree, or m_editedTree after an edit (needed to compute the old end point of the next edit).
+    QString m_text;
+    QList<SymbolEntry> m_symbolTable;
+    // Same size as m_symbolTable, nullptr until the Symbol is needed. Symbols are parented to the document, until the
+    // table is outdated (see releaseSymbols).
     QList<Core::Symbol *> m_symbols;
+    // Most recently used first
+    QList<QueryResult> m_queryResults;
+    QFuture<std::shared_ptr<BackgroundParse>> m_backgroundParse;
+    bool m_parseInBackground = false;
     int m_flags = 0;
+    int m_version = 0;
+    int m_symbolsVersion = 0;
 };
 
 } // namespace Core
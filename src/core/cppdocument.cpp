@@ -31,11 +31,14 @@
 namespace {
 using namespace Core;
 
-// We query for classes in queryClassSymbols and queryClassDefinition.
+// We query for classes in classSymbolQuery and queryClassDefinition.
 // To make sure the results of both are consistent, share the actual query by using this function.
-static QString classQuery(std::optional<QString> className)
+//
+// Names are never pasted into the queries, they are checked against the query parameters instead (here `$className`),
+// see treesitter::Predicates. This way each query is only compiled once, whatever the name looked for.
+static QString classQuery(bool withName)
 {
-    auto like_predicate = className.has_value() ? QString("(#like? @name \"%1\")").arg(*className) : "";
+    const QString like_predicate = withName ? R"EOF((#like? @name "$className"))EOF" : "";
 
     return QString(R"EOF(
         ; query classes or structs
@@ -53,22 +56,23 @@ static QString classQuery(std::optional<QString> className)
         .arg(like_predicate);
 }
 
-static QString functionDeclaratorQuery(const QString &scope, std::optional<QString> name)
+// With a name, the name must be equal to the `$functionName` parameter, and the scope (if any) like `$scope`.
+static QString functionDeclaratorQuery(bool withName, bool withScope = false)
 {
     auto identifier = QString("");
-    if (name.has_value()) {
+    if (withName) {
         // clang-format off
-        identifier = QString(R"EOF(
-            [(identifier) (field_identifier)] @name (#eq? @name "%1")
-        )EOF").arg(*name);
+        identifier = R"EOF(
+            [(identifier) (field_identifier)] @name (#eq? @name "$functionName")
+        )EOF";
 
-        if (!scope.isEmpty()) {
+        if (withScope) {
             identifier = QString(R"EOF(
                 (qualified_identifier
-                    scope: (_) @scope (#like? @scope "%1")
-                    %2
+                    scope: (_) @scope (#like? @scope "$scope")
+                    %1
                 )
-            )EOF").arg(scope, identifier);
+            )EOF").arg(identifier);
         }
         // clang-format on
     } else {
@@ -149,16 +153,16 @@ static QString methodDeclarationQuery(const QString &declarator)
         .arg(declarator);
 }
 
-auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+SymbolQuery functionSymbolQuery()
 {
-    auto functionDeclarator = functionDeclaratorQuery("", std::nullopt);
+    auto functionDeclarator = functionDeclaratorQuery(false);
     auto pointerDeclarator = pointerDeclaratorQuery(functionDeclarator, "@return");
 
     auto functionDefinition = methodDefinitionQuery(pointerDeclarator);
     auto memberFunctionDeclaration = methodDeclarationQuery(pointerDeclarator);
 
     // clang-format off
-    auto functions = document->query(QString(R"EOF(
+    auto functions = QString(R"EOF(
         [; Free function implementations
         %3
 
@@ -177,12 +181,12 @@ auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
 
         ; Member functions
         %4
-    ])EOF").arg(functionDeclarator, pointerDeclarator, functionDefinition, memberFunctionDeclaration));
+    ])EOF").arg(functionDeclarator, pointerDeclarator, functionDefinition, memberFunctionDeclaration);
     // clang-format on
 
-    auto function_to_symbol = [document](const QueryMatch &match) {
+    auto function_kind = [](const QueryMatch &match) {
         auto kind = Symbol::Kind::Function;
-        if (!match.get("return").isValid()) {
+        if (match.span("return").first == -1) {
             // No return type, this is a Constructor/Destructor
             // Clangd also assigned the Constructor kind to Destructors, so we'll do the same
             kind = Symbol::Kind::Constructor;
@@ -192,28 +196,28 @@ auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
             // to resolve the original declaration.
             kind = Symbol::Kind::Method;
         }
-        return Symbol::makeSymbol(document, match, kind);
+        return kind;
     };
 
-    return kdalgorithms::transformed<QList<Symbol *>>(functions, function_to_symbol);
+    return {.query = functions, .symbolKind = function_kind};
 }
 
-auto queryClassSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+SymbolQuery classSymbolQuery()
 {
-    auto classesAndStructs = document->query(classQuery(std::nullopt));
-    auto class_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Class);
+    auto class_kind = [](const QueryMatch &) {
+        return Symbol::Kind::Class;
     };
 
-    return kdalgorithms::transformed<QList<Symbol *>>(classesAndStructs, class_to_symbol);
+    return {.query = classQuery(false), .symbolKind = class_kind};
 }
 
-static QString membersQuery(std::optional<QString> name)
+// With a name, the member name must be equal to the `$memberName` parameter.
+static QString membersQuery(bool withName)
 {
     auto fieldIdentifier = "(field_identifier) @name @selectionRange";
     auto pointerDeclarator = pointerDeclaratorQuery(fieldIdentifier, "@type");
 
-    auto nameCheck = name.has_value() ? QString("(#eq? @name \"%1\")").arg(*name) : "";
+    const QString nameCheck = withName ? R"EOF((#eq? @name "$memberName"))EOF" : "";
 
     // clang-format off
     return QString(R"EOF(
@@ -231,43 +235,40 @@ static QString membersQuery(std::optional<QString> name)
     // clang-format on
 }
 
-auto queryMemberSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+SymbolQuery memberSymbolQuery()
 {
-    auto members = document->query(membersQuery(std::nullopt));
-
-    auto member_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Field);
+    auto member_kind = [](const QueryMatch &) {
+        return Symbol::Kind::Field;
     };
 
-    return kdalgorithms::transformed<QList<Symbol *>>(members, member_to_symbol);
+    return {.query = membersQuery(false), .symbolKind = member_kind};
 }
-auto queryEnumSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+
+QList<SymbolQuery> enumSymbolQueries()
 {
-    auto enums = document->query(R"EOF(
-        (enum_specifier
-          name: (_) @name @selectionRange) @range
-    )EOF");
-    auto enum_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Enum);
+    auto enum_kind = [](const QueryMatch &) {
+        return Symbol::Kind::Enum;
     };
-    auto result = kdalgorithms::transformed<QList<Symbol *>>(enums, enum_to_symbol);
-
-    auto enumerators = document->query(R"EOF(
-        (enumerator
-          name: (_) @name @selectionRange
-          value: (_)? @value) @range
-    )EOF");
-    result.append(kdalgorithms::transformed<QList<Symbol *>>(enumerators, enum_to_symbol));
 
-    return result;
+    return {{.query = R"EOF(
+                (enum_specifier
+                  name: (_) @name @selectionRange) @range
+            )EOF",
+             .symbolKind = enum_kind},
+            {.query = R"EOF(
+                (enumerator
+                  name: (_) @name @selectionRange
+                  value: (_)? @value) @range
+            )EOF",
+             .symbolKind = enum_kind}};
 }
-auto queryAllSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+
+// All symbols are found with a single query, see TreeSitterHelper::setSymbolQueries.
+QList<SymbolQuery> allSymbolQueries()
 {
-    auto symbols = ::queryClassSymbols(document);
-    symbols.append(::queryFunctionSymbols(document));
-    symbols.append(::queryMemberSymbols(document));
-    symbols.append(::queryEnumSymbols(document));
-    return symbols;
+    QList<SymbolQuery> queries {classSymbolQuery(), functionSymbolQuery(), memberSymbolQuery()};
+    queries.append(enumSymbolQueries());
+    return queries;
 }
 
 }
@@ -290,7 +291,7 @@ CppDocument::CppDocument(QObject *parent)
     : CodeDocument(Type::Cpp, parent)
 {
     // setup symbol query functions specific to c++
-    helper()->querySymbols = ::queryAllSymbols;
+    helper()->setSymbolQueries(::allSymbolQueries());
 }
 CppDocument::~CppDocument() = default;
 
@@ -322,7 +323,7 @@ void CppDocument::commentSelection()
 {
     LOG();
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
 
     const int cursorPos = cursor.position();
@@ -390,7 +391,7 @@ void CppDocument::commentSelection()
     }
 
     cursor.endEditBlock();
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 static QStringList matchingSuffixes(bool header)
@@ -459,14 +460,9 @@ QString CppDocument::correspondingHeaderSource() const
     }
 
     // Search in the whole project, and find the possible files
-    QStringList fullPathNames = Project::instance()->allFilesWithExtensions(suffixes, Project::FullPath);
-    auto notCandidate = [&candidates](const QString &path) {
-        auto notInPath = [&path](const QString &candidate) {
-            return !path.endsWith(candidate, Qt::CaseInsensitive);
-        };
-        return kdalgorithms::all_of(candidates, notInPath);
-    };
-    kdalgorithms::erase_if(fullPathNames, notCandidate);
+    QStringList fullPathNames;
+    for (const auto &candidate : candidates)
+        fullPathNames.append(Project::instance()->allFilesWithName(candidate, Project::FullPath));
 
     // Find the file having the most common path with fileName
     QString bestFileName;
@@ -512,7 +508,7 @@ void CppDocument::removeLines(const RangeMark &rangeMark)
 {
     LOG(rangeMark.text());
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(rangeMark.start());
     cursor.movePosition(QTextCursor::StartOfBlock);
     cursor.setPosition(rangeMark.end(), QTextCursor::KeepAnchor);
@@ -553,9 +549,9 @@ Core::QueryMatch CppDocument::queryClassDefinition(const QString &className)
 {
     LOG(LOG_ARG("className", className));
 
-    const auto classDefinitionQuery = classQuery({className});
+    static const auto classDefinitionQuery = classQuery(true);
 
-    auto matches = query(classDefinitionQuery);
+    auto matches = query(helper()->constructQuery(classDefinitionQuery), {}, {{"className", className}});
     if (matches.isEmpty()) {
         spdlog::warn("{}: No class named `{}` found in `{}`", FUNCTION_NAME, className, fileName());
         return {};
@@ -591,24 +587,25 @@ Core::QueryMatchList CppDocument::queryMethodDefinition(const QString &scope, co
 {
     LOG(LOG_ARG("scope", scope), LOG_ARG("functionName", functionName));
 
-    const auto functionDeclarator = functionDeclaratorQuery(scope, {functionName});
+    const auto functionDeclarator = functionDeclaratorQuery(true, !scope.isEmpty());
     const auto pointerDeclaration = pointerDeclaratorQuery(functionDeclarator, "@return");
-    return query(methodDefinitionQuery(pointerDeclaration));
+    return query(helper()->constructQuery(methodDefinitionQuery(pointerDeclaration)), {},
+                 {{"scope", scope}, {"functionName", functionName}});
 }
 
 QList<QueryMatch> CppDocument::internalQueryFunctionCall(const QString &functionName, const QString &argumentsQuery)
 {
     const auto queryString = QString(R"EOF(
                 (call_expression
-                    function: (_) @name (#eq? @name "%1")
+                    function: (_) @name (#eq? @name "$functionName")
                     arguments: (argument_list
-                            %2
+                            %1
                         ) @argument-list
                 ) @call
     )EOF")
-                                 .arg(functionName, argumentsQuery);
+                                 .arg(argumentsQuery);
 
-    return query(queryString);
+    return query(helper()->constructQuery(queryString), {}, {{"functionName", functionName}});
 }
 
 /*!
@@ -696,7 +693,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
         return false;
     }
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(symbol->range().end());
     cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor);
     if (cursor.selectedText() != "}") {
@@ -712,7 +709,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     const QString strTab = tab();
     if (insertAt == StartOfMethod) {
         // Goto the start of the block
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         cursor.setPosition(gotoBlockStart());
         // Move forward one character
         cursor.movePosition(QTextCursor::NextCharacter);
@@ -736,7 +733,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     cursor.insertText(code);
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     return true;
 }
@@ -779,7 +776,7 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
     qualifierList.pop_front();
 
     // Check if the declaration already exists
-    QTextDocument *doc = textEdit()->document();
+    QTextDocument *doc = qTextDocument();
     QTextCursor cursor(doc);
     cursor = doc->find(result, cursor, QTextDocument::FindWholeWords);
     if (!cursor.isNull()) {
@@ -803,9 +800,9 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
     }
 
     if (pos != -1) {
-        auto cur = textEdit()->textCursor();
+        auto cur = textCursor();
         cur.setPosition(pos);
-        textEdit()->setTextCursor(cur);
+        setTextCursor(cur);
         cur.beginEditBlock();
         cur.movePosition(QTextCursor::EndOfLine, QTextCursor::MoveAnchor);
         cur.insertText("\n\n" + result);
@@ -852,7 +849,7 @@ DataExchange CppDocument::mfcExtractDDX(const QString &className)
  */
 MessageMap CppDocument::mfcExtractMessageMap(const QString &className /* = ""*/)
 {
-    auto checkClassName = className.isEmpty() ? "" : QString("(#eq? @class \"%1\")").arg(className);
+    const QString checkClassName = className.isEmpty() ? "" : R"EOF((#eq? @class "$className"))EOF";
 
     // clang-format off
     const auto messageMapQueryString = QString(R"EOF(
@@ -902,7 +899,7 @@ MessageMap CppDocument::mfcExtractMessageMap(const QString &className /* = ""*/)
     // We assume there is at most one MessageMap per file.
     // This allows us to return immediately after the message map is found.
     // As the MessageMap query is quite complicated, this can significantly improve performance.
-    auto match = queryFirst(queryString);
+    auto match = queryFirst(helper()->constructQuery(queryString), {}, {{"className", className}});
     if (match.isEmpty()) {
         spdlog::warn("{}: No message map found in `{}`", FUNCTION_NAME, fileName());
         return {};
@@ -941,17 +938,17 @@ Core::QueryMatchList CppDocument::queryMethodDeclaration(const QString &classNam
         return {};
     }
 
-    auto functionDeclarator = functionDeclaratorQuery("", {functionName});
+    auto functionDeclarator = functionDeclaratorQuery(true);
 
     // clang-format off
     auto destructorDeclarator = QString(R"EOF(
         (function_declarator
-            declarator: (destructor_name) @name (#eq? @name "%1")
+            declarator: (destructor_name) @name (#eq? @name "$functionName")
 
              ; The parameter-list of a destructor must be empty.
              ; No point in capturing individual parameters
             parameters: (parameter_list) @parameter-list)
-    )EOF").arg(functionName);
+    )EOF");
 
     auto queryString = QString(R"EOF(
         [
@@ -970,7 +967,7 @@ Core::QueryMatchList CppDocument::queryMethodDeclaration(const QString &classNam
                destructorDeclarator);
     // clang-format on
 
-    auto matches = classQuery.queryIn("body", queryString);
+    auto matches = queryInRanges(classQuery.getAll("body"), queryString, {}, {{"functionName", functionName}});
     if (matches.isEmpty()) {
         spdlog::warn("{}: No method named `{}` found in `{}`", FUNCTION_NAME, functionName, fileName());
     }
@@ -998,7 +995,8 @@ Core::QueryMatch CppDocument::queryMember(const QString &className, const QStrin
 
     auto classQuery = queryClassDefinition(className);
 
-    auto matches = classQuery.queryIn("body", membersQuery(memberName));
+    static const auto memberQuery = membersQuery(true);
+    auto matches = queryInRanges(classQuery.getAll("body"), memberQuery, {}, {{"memberName", memberName}});
     if (matches.isEmpty()) {
         spdlog::warn("{}: No member named `{}` found in `{}`", FUNCTION_NAME, memberName, fileName());
         return {};
@@ -1020,12 +1018,12 @@ int CppDocument::gotoBlockStart(int count)
 {
     LOG_AND_MERGE(count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -1039,12 +1037,12 @@ int CppDocument::gotoBlockEnd(int count)
 {
     LOG_AND_MERGE(count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -1058,7 +1056,7 @@ int CppDocument::selectBlockStart(int count)
 {
     LOG_AND_MERGE(count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::max(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
@@ -1069,7 +1067,7 @@ int CppDocument::selectBlockStart(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockStartPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockStartPos;
 }
 
@@ -1083,7 +1081,7 @@ int CppDocument::selectBlockEnd(int count)
 {
     LOG_AND_MERGE(count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::min(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
@@ -1094,7 +1092,7 @@ int CppDocument::selectBlockEnd(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -1108,7 +1106,7 @@ int CppDocument::selectBlockUp(int count)
 {
     LOG_AND_MERGE(count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
@@ -1118,7 +1116,7 @@ int CppDocument::selectBlockUp(int count)
     cursor.setPosition(blockStartPos, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -1132,11 +1130,11 @@ int CppDocument::moveBlock(int startPos, QTextCursor::MoveOperation direction)
 {
     Q_ASSERT(direction == QTextCursor::NextCharacter || direction == QTextCursor::PreviousCharacter);
 
-    QTextDocument *doc = textEdit()->document();
+    QTextDocument *doc = qTextDocument();
     Q_ASSERT(doc);
 
     const int inc = direction == QTextCursor::NextCharacter ? 1 : -1;
-    const int lastPos = direction == QTextCursor::NextCharacter ? textEdit()->document()->characterCount() - 1 : 0;
+    const int lastPos = direction == QTextCursor::NextCharacter ? qTextDocument()->characterCount() - 1 : 0;
     if (startPos == lastPos)
         return startPos;
     int pos = startPos + inc;
@@ -1205,7 +1203,7 @@ void CppDocument::toggleSection()
     const auto elseString = QStringLiteral("#else // ") + sectionSettings.tag;
     const auto newLine = QStringLiteral("\n");
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     if (cursor.hasSelection()) {
         // If there's a selection, just add #ifdef/#endif
         cursor.beginEditBlock();
@@ -1219,7 +1217,7 @@ void CppDocument::toggleSection()
         cursor.insertText(ifdefString + newLine);
         // Move after the #endif
         cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         gotoLine(line + 3);
 
     } else {
@@ -1241,7 +1239,7 @@ void CppDocument::toggleSection()
 
         if (cursor.selectedText().startsWith(endifString)) {
             // The function is already commented out, remove the comments
-            int start = textEdit()->document()->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
+            int start = qTextDocument()->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
             if (start > symbol->range().start())
                 cursor.setPosition(start, QTextCursor::KeepAnchor);
             cursor.removeSelectedText();
@@ -1278,7 +1276,7 @@ void CppDocument::toggleSection()
             cursorPos += ifdefString.length() + 1;
         }
         cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         setPosition(cursorPos);
     }
 }
@@ -1445,9 +1443,9 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 
     QString indent = "\n\n";
 
-    auto lastBracePos = textEdit()->toPlainText().lastIndexOf('}');
+    auto lastBracePos = qTextDocument()->toPlainText().lastIndexOf('}');
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
 
     cursor.setPosition(lastBracePos + 1);
@@ -1455,11 +1453,11 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 
     // Add the method definition
     cursor.insertText(indent + methodDef);
-    auto methodStartPos = textEdit()->toPlainText().lastIndexOf('{');
+    auto methodStartPos = qTextDocument()->toPlainText().lastIndexOf('{');
     cursor.setPosition(methodStartPos + 1); // move to position after opening brace
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return true;
 }
 
@@ -1573,7 +1571,13 @@ void CppDocument::deleteMethodLocal(const QString &methodName, const QString &si
             return !isFunction || symbol->name() != methodName || symbol->toFunction()->signature() != signature;
     };
 
-    auto symbolList = symbols();
+    // Only create the Symbol objects of the symbols with the right name.
+    QList<Symbol *> symbolList;
+    const auto &symbolTable = helper()->symbolTable();
+    for (qsizetype i = 0; i < symbolTable.size(); ++i) {
+        if (symbolTable.at(i).name == methodName)
+            symbolList.push_back(helper()->symbol(i));
+    }
     kdalgorithms::erase_if(symbolList, doesNotMatchMethod);
     if (symbolList.empty())
         return;
@@ -1777,72 +1781,17 @@ QStringList CppDocument::primitiveTypes() const
 
 QList<treesitter::Range> CppDocument::includedRanges() const
 {
-    auto macros = Settings::instance()->value<QStringList>(Settings::CppExcludedMacros);
-    if (macros.isEmpty()) {
-        return {};
-    }
-
-    QRegularExpression regex(macros.join("|"));
-    if (!regex.isValid()) {
-        spdlog::error("{}: Failed to create regex for excluded macros: {}", FUNCTION_NAME, regex.errorString());
-        return {};
-    }
-
-    auto document = textEdit()->document();
-
-    QList<treesitter::Range> ranges;
-    treesitter::Point lastPoint {0, 0};
-    uint32_t lastByte = 0;
-
-    for (auto block = document->firstBlock(); block.isValid(); block = block.next()) {
-        QRegularExpressionMatch match;
-        auto searchFrom = 0;
-        auto index = block.text().indexOf(regex, searchFrom, &match);
-
-        // Run this in a loop to support multiple macros on the same line.
-        while (index != -1) {
-            // We need to construct a range from the end of the last match to the start of the current match.
-            //
-            // Note that the ranges have an inclusive start and an exclusive end..
-            //
-            // Also Note that the column seems to be in bytes, not characters.
-            // This is why we multiply by sizeof(QChar) to get the correct column.
-            // At least that's what the TreeSitterInspector shows us.
-            auto endPoint = treesitter::Point {.row = static_cast<uint32_t>(block.blockNumber()),
-                                               .column = static_cast<uint32_t>(index * sizeof(QChar))};
-            ranges.push_back({.start_point = lastPoint,
-                              .end_point = endPoint,
-                              .start_byte = lastByte,
-                              // No need to add - 1 here, the ranges are exclusive at the end.
-                              .end_byte = static_cast<uint32_t>((block.position() + index) * sizeof(QChar))});
-
-            auto matchLength = match.capturedLength();
-            lastByte = static_cast<uint32_t>((block.position() + index + matchLength) * sizeof(QChar));
-            lastPoint = {.row = static_cast<uint32_t>(block.blockNumber()),
-                         .column = static_cast<uint32_t>((index + matchLength) * sizeof(QChar))};
-            if (lastPoint.column == static_cast<uint32_t>(block.length())) {
-                ++lastPoint.row;
-                lastPoint.column = 0;
-            }
-
-            searchFrom = index + matchLength;
-            index = block.text().indexOf(regex, searchFrom, &match);
-        }
-    }
-
-    if (!ranges.isEmpty()) {
-        // Add the last range, up to the end of the document, but only if we have another range.
-        // Leaving the ranges empty will parse the entire document, so that's easiest.
-        auto endPoint =
-            treesitter::Point {.row = static_cast<uint32_t>(document->blockCount() - 1),
-                               .column = static_cast<uint32_t>(document->lastBlock().length() * sizeof(QChar))};
-        ranges.push_back({.start_point = lastPoint,
-                          .end_point = endPoint,
-                          .start_byte = lastByte,
-                          .end_byte = static_cast<uint32_t>(document->characterCount() * sizeof(QChar))});
-    }
+    // The macros are kept up to date while editing, see changeIncludedRanges, so only the first call scans the whole
+    // document.
+    if (!m_excludedMacros)
+        m_excludedMacros = std::make_unique<ExcludedMacros>(qTextDocument());
+    return m_excludedMacros->includedRanges();
+}
 
-    return ranges;
+void CppDocument::changeIncludedRanges(int position, int charsRemoved, int charsAdded)
+{
+    if (m_excludedMacros)
+        m_excludedMacros->edit(position, charsRemoved, charsAdded);
 }
 
 } // namespace Core
@@ -15,12 +15,16 @@
 #include "messagemap.h"
 #include "symbol.h"
 
+#include <memory>
+
 #ifndef Q_MOC_RUN
 #define API_EXECUTOR
 #endif
 
 namespace Core {
 
+class ExcludedMacros;
+
 class CppDocument : public CodeDocument
 {
     Q_OBJECT
@@ -65,6 +69,9 @@ public:
 
     QList<treesitter::Range> includedRanges() const override;
 
+protected:
+    void changeIncludedRanges(int position, int charsRemoved, int charsAdded) override;
+
 public slots:
     Core::CppDocument *openHeaderSource();
 
@@ -117,6 +124,9 @@ private:
     void changeBaseClassForwardInclude(const QString &originalClassBaseName, const QString &newClassBaseName);
 
     friend class IncludeHelper;
+
+    // Created on first use, see includedRanges.
+    mutable std::unique_ptr<ExcludedMacros> m_excludedMacros;
 };
 
 } // namespace Core
@@ -9,7 +9,14 @@
 */
 
 #include "cppdocument_p.h"
+#include "codedocument_p.h"
 #include "cppdocument.h"
+#include "settings.h"
+#include "utils/log.h"
+
+#include <QPointer>
+#include <QTextBlock>
+#include <QTextDocument>
 
 namespace Core {
 
@@ -123,13 +130,15 @@ IncludeHelper::IncludePosition IncludeHelper::findBestFirstIncludeLine() const
 
 void IncludeHelper::computeIncludes()
 {
-    const auto results = m_document->query(Queries::findInclude);
+    // Includes are computed for each include added or removed, only look for them again where the document changed.
+    const auto &helper = m_document->helper();
+    const auto results = helper->cachedQuery(helper->constructQuery(Queries::findInclude));
 
     // Extract all includes
     int lastLine = -1;
 
-    for (const auto &match : results) {
-        auto includePath = match.get("path");
+    for (const auto &result : results) {
+        auto includePath = result.match.get("path");
         int line; // 1-based
         int col;
         m_document->convertPosition(includePath.end(), &line, &col);
@@ -160,4 +169,165 @@ void IncludeHelper::computeIncludes()
         processGroup(group);
 }
 
+ExcludedMacros::ExcludedMacros(QTextDocument *document)
+    : m_document(document)
+{
+}
+
+const ExcludedMacros::Matcher &ExcludedMacros::matcher()
+{
+    static Matcher matcher;
+    static bool isOutdated = true;
+    static QPointer<Settings> settings;
+
+    // Tests create a new Settings instance, make sure to listen to the current one.
+    if (settings != Settings::instance()) {
+        settings = Settings::instance();
+        isOutdated = true;
+        QObject::connect(settings, &Settings::settingsChanged, settings, [](const QString &path) {
+            // The path may be the one of the setting, or of one of its parents.
+            const QString macrosPath = Settings::CppExcludedMacros;
+            if (macrosPath.startsWith(path) || path.startsWith(macrosPath))
+                isOutdated = true;
+        });
+        QObject::connect(settings, &Settings::settingsLoaded, settings, []() {
+            isOutdated = true;
+        });
+    }
+
+    if (isOutdated) {
+        isOutdated = false;
+        ++matcher.generation;
+        matcher.regex.reset();
+
+        const auto macros = Settings::instance()->value<QStringList>(Settings::CppExcludedMacros);
+        if (!macros.isEmpty()) {
+            QRegularExpression regex(macros.join("|"));
+            if (regex.isValid()) {
+                regex.optimize();
+                matcher.regex = std::move(regex);
+            } else {
+                spdlog::error("{}: Failed to create regex for excluded macros: {}", FUNCTION_NAME, regex.errorString());
+            }
+        }
+    }
+    return matcher;
+}
+
+QList<std::pair<int, int>> ExcludedMacros::scan(const QTextBlock &first, const QTextBlock &last) const
+{
+    const auto &regex = *matcher().regex;
+
+    QList<std::pair<int, int>> macros;
+    for (auto block = first; block.isValid(); block = block.next()) {
+        const auto blockText = block.text();
+        QRegularExpressionMatch match;
+        auto index = blockText.indexOf(regex, 0, &match);
+
+        // Run this in a loop to support multiple macros on the same line.
+        while (index != -1) {
+            const auto matchLength = static_cast<int>(match.capturedLength());
+            macros.emplace_back(block.position() + index, block.position() + index + matchLength);
+            // Don't get stuck on an empty match.
+            index = blockText.indexOf(regex, index + std::max(matchLength, 1), &match);
+        }
+
+        if (block == last)
+            break;
+    }
+    return macros;
+}
+
+void ExcludedMacros::edit(int position, int charsRemoved, int charsAdded)
+{
+    const auto &matcher = this->matcher();
+    // Without any macro there's nothing to update, and with a new setting everything is scanned again anyway.
+    if (!matcher.regex || m_generation != matcher.generation)
+        return;
+
+    // The macros are found line by line, scan all lines touched by the change again.
+    const auto first = m_document->findBlock(position);
+    auto last = m_document->findBlock(position + charsAdded);
+    if (!last.isValid())
+        last = m_document->lastBlock();
+    const int scanStart = first.position();
+    const int scanEnd = last.position() + last.length();
+
+    QList<std::pair<int, int>> macros;
+    macros.reserve(m_macros.size());
+    auto it = m_macros.cbegin();
+    // Before the change, nothing moves.
+    for (; it != m_macros.cend() && it->first < scanStart; ++it)
+        macros.push_back(*it);
+    macros.append(scan(first, last));
+    // After the change, the macros are shifted, the ones in the scanned lines were found again.
+    const int delta = charsAdded - charsRemoved;
+    for (; it != m_macros.cend(); ++it) {
+        if (it->first >= position + charsRemoved && it->first + delta >= scanEnd)
+            macros.emplace_back(it->first + delta, it->second + delta);
+    }
+    m_macros = std::move(macros);
+}
+
+QList<treesitter::Range> ExcludedMacros::includedRanges()
+{
+    const auto &matcher = this->matcher();
+    if (!matcher.regex) {
+        m_generation = matcher.generation;
+        m_macros.clear();
+        return {};
+    }
+
+    if (m_generation != matcher.generation) {
+        m_generation = matcher.generation;
+        m_macros = scan(m_document->firstBlock(), m_document->lastBlock());
+    }
+
+    QList<treesitter::Range> ranges;
+    treesitter::Point lastPoint {0, 0};
+    uint32_t lastByte = 0;
+
+    for (const auto &[start, end] : std::as_const(m_macros)) {
+        const auto block = m_document->findBlock(start);
+        const auto index = start - block.position();
+
+        // We need to construct a range from the end of the last match to the start of the current match.
+        //
+        // Note that the ranges have an inclusive start and an exclusive end..
+        //
+        // Also Note that the column seems to be in bytes, not characters.
+        // This is why we multiply by sizeof(QChar) to get the correct column.
+        // At least that's what the TreeSitterInspector shows us.
+        auto endPoint = treesitter::Point {.row = static_cast<uint32_t>(block.blockNumber()),
+                                           .column = static_cast<uint32_t>(index * sizeof(QChar))};
+        ranges.push_back({.start_point = lastPoint,
+                          .end_point = endPoint,
+                          .start_byte = lastByte,
+                          // No need to add - 1 here, the ranges are exclusive at the end.
+                          .end_byte = static_cast<uint32_t>(start * sizeof(QChar))});
+
+        lastByte = static_cast<uint32_t>(end * sizeof(QChar));
+        lastPoint = {.row = static_cast<uint32_t>(block.blockNumber()),
+                     .column = static_cast<uint32_t>((end - block.position()) * sizeof(QChar))};
+        if (lastPoint.column == static_cast<uint32_t>(block.length())) {
+            ++lastPoint.row;
+            lastPoint.column = 0;
+        }
+    }
+
+    if (!ranges.isEmpty()) {
+        // Add the last range, up to the end of the document, but only if we have another range.
+        // Leaving the ranges empty will parse the entire document, so that's easiest.
+        auto endPoint =
+            treesitter::Point {.row = static_cast<uint32_t>(m_document->blockCount() - 1),
+                               .column = static_cast<uint32_t>(m_document->lastBlock().length() * sizeof(QChar))};
+        ranges.push_back({.start_point = lastPoint,
+                          .end_point = endPoint,
+                          .start_byte = lastByte,
+                          .end_byte = static_cast<uint32_t>(m_document->characterCount() * sizeof(QChar))});
+    }
+
+    return ranges;
+}
+
 }
@@ -10,12 +10,18 @@
 
 #pragma once
 
+#include "treesitter/parser.h"
 #include "utils/json.h"
 
+#include <QList>
+#include <QRegularExpression>
 #include <map>
 #include <optional>
 #include <vector>
 
+class QTextBlock;
+class QTextDocument;
+
 namespace Core {
 
 class CppDocument;
@@ -134,4 +140,43 @@ private:
     IncludeGroups m_includeGroups;
 };
 
+/**
+ * Positions of the excluded macros (see Settings::CppExcludedMacros) of a document, for CppDocument::includedRanges.
+ * They are kept up to date while the document is edited: only the blocks touched by an edit are scanned again.
+ */
+class ExcludedMacros
+{
+public:
+    explicit ExcludedMacros(QTextDocument *document);
+
+    QList<treesitter::Range> includedRanges();
+    // Must be called for each change of the document, before includedRanges.
+    void edit(int position, int charsRemoved, int charsAdded);
+
+private:
+    struct Matcher
+    {
+        // Empty if there are no excluded macros, or if the setting is invalid.
+        std::optional<QRegularExpression> regex;
+        // Incremented each time the setting changes, the documents then need to be scanned again.
+        int generation = 0;
+    };
+    /**
+     * Returns the matcher for the excluded macros, shared by all documents.
+     * The regular expression is only compiled again when the setting changes.
+     */
+    static const Matcher &matcher();
+
+    /**
+     * Returns the excluded macros of the blocks from first to last (included), sorted by position.
+     */
+    QList<std::pair<int, int>> scan(const QTextBlock &first, const QTextBlock &last) const;
+
+    QTextDocument *const m_document;
+    // Generation of the matcher used to find the macros, -1 if the document wasn't scanned yet.
+    int m_generation = -1;
+    // Start and end positions of the excluded macros, sorted.
+    QList<std::pair<int, int>> m_macros;
+};
+
 } // namespace Core
@@ -15,7 +15,7 @@
 
 namespace {
 
-QList<Core::Symbol *> queryAllSymbols(Core::CodeDocument *const document)
+QList<Core::SymbolEntry> queryAllSymbols(Core::CodeDocument *const document)
 {
     Q_UNUSED(document);
     // TODO
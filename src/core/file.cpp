@@ -10,12 +10,20 @@
 
 #include "file.h"
 #include "logger.h"
+#include "project.h"
 
 #include <QFile>
 #include <QTextStream>
 
 namespace Core {
 
+static bool updateProjectFiles(bool success, const QStringList &fileNames)
+{
+    if (success)
+        Project::instance()->updateFiles(fileNames);
+    return success;
+}
+
 /*!
  * \qmltype File
  * \brief Singleton with methods to handle files.
@@ -38,7 +46,7 @@ File::~File() = default;
 bool File::copy(const QString &fileName, const QString &newName)
 {
     LOG(fileName, newName);
-    return QFile::copy(fileName, newName);
+    return updateProjectFiles(QFile::copy(fileName, newName), {newName});
 }
 
 /*!
@@ -56,7 +64,7 @@ bool File::exists(const QString &fileName)
 bool File::remove(const QString &fileName)
 {
     LOG(fileName);
-    return QFile::remove(fileName);
+    return updateProjectFiles(QFile::remove(fileName), {fileName});
 }
 
 /*!
@@ -65,7 +73,7 @@ bool File::remove(const QString &fileName)
 bool File::rename(const QString &oldName, const QString &newName)
 {
     LOG(oldName, newName);
-    return QFile::rename(oldName, newName);
+    return updateProjectFiles(QFile::rename(oldName, newName), {oldName, newName});
 }
 
 /*!
@@ -75,7 +83,7 @@ bool File::touch(const QString &fileName)
 {
     LOG(fileName);
     QFile file(fileName);
-    return file.open(QFile::Append);
+    return updateProjectFiles(file.open(QFile::Append), {fileName});
 }
 
 /*!
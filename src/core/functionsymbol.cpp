@@ -96,7 +96,7 @@ QList<FunctionArgument> FunctionSymbol::argumentsFromQueryMatch() const
 {
     auto arguments = m_queryMatch.getAll("parameters");
     auto to_function_arg = [this](const RangeMark &argument) {
-        auto result = document()->queryInRange(argument, "(identifier) @name");
+        auto result = document() ? document()->queryInRange(argument, "(identifier) @name") : Core::QueryMatchList();
         auto nameRange = result.isEmpty() ? RangeMark() : result.first().get("name");
         auto name = nameRange.text().simplified();
         auto type = argument.textExcept(nameRange).simplified();
@@ -23,7 +23,7 @@ namespace Core::Utils {
 {
     Lsp::Position position;
 
-    auto cursor = textDocument.textEdit()->textCursor();
+    auto cursor = textDocument.textCursor();
     cursor.setPosition(pos, QTextCursor::MoveAnchor);
 
     position.line = cursor.blockNumber();
@@ -33,7 +33,7 @@ namespace Core::Utils {
 
 int lspToPos(const TextDocument &textDocument, const Lsp::Position &pos)
 {
-    auto document = textDocument.textEdit()->document();
+    auto document = textDocument.qTextDocument();
     // Internally, columns are 0-based, like in LSP
     const int blockNumber = qMin((int)pos.line, document->blockCount() - 1);
     const QTextBlock &block = document->findBlockByNumber(blockNumber);
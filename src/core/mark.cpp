@@ -16,6 +16,8 @@
 
 #include <QPlainTextEdit>
 #include <QTextDocument>
+#include <algorithm>
+#include <utility>
 
 namespace Core {
 
@@ -48,79 +50,397 @@ namespace Core {
  * This read-only property returns the document the mark is coming from.
  */
 
-bool MarkPrivate::checkEditor() const
+MarkTable::MarkTable(TextDocument *document)
+    : QObject(document)
+    , m_document(document)
 {
-    if (!m_editor) {
-        spdlog::error("{}: - document does not exist anymore", FUNCTION_NAME);
-        return false;
+    connect(document->qTextDocument(), &QTextDocument::contentsChange, this, &MarkTable::update);
+}
+
+TextDocument *MarkTable::document() const
+{
+    return m_document;
+}
+
+int MarkTable::add(int position)
+{
+    int id;
+    if (m_freeSlots.empty()) {
+        id = static_cast<int>(m_slots.size());
+        m_slots.emplace_back();
+    } else {
+        id = m_freeSlots.back();
+        m_freeSlots.pop_back();
     }
-    return true;
+    m_slots[id] = {.index = -1, .position = position, .refs = 1};
+    m_pending.push_back(id);
+
+    if (m_pending.size() >= MaxPending)
+        merge();
+    return id;
 }
 
-bool MarkPrivate::isValid() const
+void MarkTable::ref(int id)
 {
-    return m_editor && m_pos >= 0;
+    ++m_slots[id].refs;
 }
 
-int MarkPrivate::line() const
+void MarkTable::deref(int id)
 {
-    if (!checkEditor())
-        return -1;
+    auto &slot = m_slots[id];
+    if (--slot.refs > 0)
+        return;
 
-    int line, column;
-    m_editor->convertPosition(m_pos, &line, &column);
-    return line;
+    if (slot.index >= 0) {
+        m_ids[slot.index] = -1;
+        ++m_released;
+    } else {
+        auto it = std::find(m_pending.begin(), m_pending.end(), id);
+        Q_ASSERT(it != m_pending.end());
+        *it = m_pending.back();
+        m_pending.pop_back();
+    }
+    m_freeSlots.push_back(id);
+
+    // Released marks are still updated on each edit, drop them once they are the majority.
+    if (m_released >= MaxPending && m_released > m_ids.size() / 2)
+        merge();
 }
 
-int MarkPrivate::column() const
+int MarkTable::position(int id) const
 {
-    if (!checkEditor())
-        return -1;
+    const auto &slot = m_slots[id];
+    return slot.index >= 0 ? sortedPosition(slot.index) : slot.position;
+}
 
-    int line, column;
-    m_editor->convertPosition(m_pos, &line, &column);
-    return column;
+void MarkTable::update(int from, int charsRemoved, int charsAdded)
+{
+    if (!m_replacements.empty()) {
+        updateReplacements();
+        return;
+    }
+
+    for (int id : m_pending)
+        Mark::updateMark(m_slots[id].position, from, charsRemoved, charsAdded);
+
+    // Same as Mark::updateMark: marks inside the removed text move to from, the ones after it are shifted.
+    const int first = lowerBound(from);
+    const int last = charsRemoved > 0 ? lowerBound(from + charsRemoved) : first;
+    for (int index = first; index < last; ++index)
+        m_base[index] = from - shift(index);
+    if (charsAdded != charsRemoved)
+        addShift(last, charsAdded - charsRemoved);
+
+    updateLazy([=](int &position) {
+        Mark::updateMark(position, from, charsRemoved, charsAdded);
+    });
+}
+
+void MarkTable::setReplacements(std::vector<Replacement> &&replacements)
+{
+    m_replacements = std::move(replacements);
+    m_replacementShifts.clear();
+    m_replacementShifts.reserve(m_replacements.size());
+    int shift = 0;
+    for (const auto &replacement : m_replacements) {
+        shift += replacement.length - (replacement.end - replacement.start);
+        m_replacementShifts.push_back(shift);
+    }
+}
+
+void MarkTable::updateReplacements()
+{
+    // The replacements don't change the order of the marks either: once merged, all positions can be updated in place.
+    merge();
+    for (auto &position : m_base)
+        position = replacedPosition(position);
+
+    updateLazy([this](int &position) {
+        position = replacedPosition(position);
+    });
+
+    m_replacements.clear();
+    m_replacementShifts.clear();
+}
+
+int MarkTable::replacedPosition(int position) const
+{
+    // Like Mark::updateMark, the marks at the end of a replacement are shifted, and the ones inside it move to its
+    // start. The replacements are sorted, so are their ends.
+    const auto it = std::upper_bound(m_replacements.cbegin(), m_replacements.cend(), position,
+                                     [](int position, const Replacement &replacement) {
+                                         return position < replacement.end;
+                                     });
+    const auto index = std::distance(m_replacements.cbegin(), it);
+    const int shift = index > 0 ? m_replacementShifts[index - 1] : 0;
+    if (it != m_replacements.cend() && it->start <= position)
+        return it->start + shift;
+    return position + shift;
+}
+
+void MarkTable::updateLazy(const std::function<void(int &)> &updatePosition)
+{
+    // Drops the deleted ranges, and the ones whose ranges are all tracked by range marks now.
+    std::erase_if(m_lazy, [&updatePosition](const auto &weakRanges) {
+        const auto ranges = weakRanges.lock();
+        return !ranges || !ranges->update(updatePosition);
+    });
+    m_lazyLimit = std::max(MaxPending, 2 * m_lazy.size());
+}
+
+void MarkTable::addLazy(const std::shared_ptr<LazyRangeMarks> &ranges)
+{
+    // Without edits, the ranges deleted in the meantime pile up: remove them from time to time.
+    if (m_lazy.size() >= m_lazyLimit) {
+        std::erase_if(m_lazy, [](const auto &weakRanges) {
+            return weakRanges.expired();
+        });
+        m_lazyLimit = std::max(MaxPending, 2 * m_lazy.size());
+    }
+    m_lazy.push_back(ranges);
+}
+
+int MarkTable::sortedPosition(int index) const
+{
+    return m_base[index] + shift(index);
+}
+
+int MarkTable::shift(int index) const
+{
+    int sum = 0;
+    for (int i = index + 1; i > 0; i -= i & -i)
+        sum += m_shifts[i];
+    return sum;
+}
+
+void MarkTable::addShift(int index, int delta)
+{
+    const int size = static_cast<int>(m_base.size());
+    for (int i = index + 1; i <= size; i += i & -i)
+        m_shifts[i] += delta;
+}
+
+int MarkTable::lowerBound(int position) const
+{
+    int low = 0;
+    int high = static_cast<int>(m_base.size());
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (sortedPosition(middle) < position)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+void MarkTable::merge()
+{
+    // Pairs of position and slot id.
+    std::vector<std::pair<int, int>> marks;
+    marks.reserve(m_ids.size() - m_released + m_pending.size());
+    for (size_t index = 0; index < m_ids.size(); ++index) {
+        if (m_ids[index] != -1)
+            marks.emplace_back(sortedPosition(static_cast<int>(index)), m_ids[index]);
+    }
+    const auto sortedCount = static_cast<std::ptrdiff_t>(marks.size());
+    for (int id : m_pending)
+        marks.emplace_back(m_slots[id].position, id);
+
+    const auto byPosition = [](const auto &left, const auto &right) {
+        return left.first < right.first;
+    };
+    std::sort(marks.begin() + sortedCount, marks.end(), byPosition);
+    std::inplace_merge(marks.begin(), marks.begin() + sortedCount, marks.end(), byPosition);
+
+    m_ids.resize(marks.size());
+    m_base.resize(marks.size());
+    m_shifts.assign(marks.size() + 1, 0);
+    for (size_t index = 0; index < marks.size(); ++index) {
+        const auto &[position, id] = marks[index];
+        m_base[index] = position;
+        m_ids[index] = id;
+        m_slots[id].index = static_cast<int>(index);
+    }
+    m_pending.clear();
+    m_released = 0;
+}
+
+std::shared_ptr<LazyRangeMarks> LazyRangeMarks::create(TextDocument *document, QList<std::pair<int, int>> &&ranges)
+{
+    // Not using std::make_shared, so the memory is released even if the table still has a weak_ptr on it.
+    std::shared_ptr<LazyRangeMarks> result(new LazyRangeMarks(document, std::move(ranges)));
+    if (!result->m_ranges.isEmpty())
+        document->markTable()->addLazy(result);
+    return result;
+}
+
+LazyRangeMarks::LazyRangeMarks(TextDocument *document, QList<std::pair<int, int>> &&ranges)
+    : m_document(document)
+    , m_ranges(std::move(ranges))
+{
+}
+
+qsizetype LazyRangeMarks::size() const
+{
+    return m_ranges.size();
+}
+
+int LazyRangeMarks::start(qsizetype index) const
+{
+    if (!m_marks.isEmpty() && m_marks.at(index))
+        return m_marks.at(index)->start();
+    return m_document ? m_ranges.at(index).first : -1;
+}
+
+int LazyRangeMarks::end(qsizetype index) const
+{
+    if (!m_marks.isEmpty() && m_marks.at(index))
+        return m_marks.at(index)->end();
+    return m_document ? m_ranges.at(index).second : -1;
+}
+
+TextDocument *LazyRangeMarks::document() const
+{
+    return m_document;
+}
+
+RangeMark LazyRangeMarks::at(qsizetype index)
+{
+    if (!m_document)
+        return {};
+
+    if (m_marks.isEmpty())
+        m_marks.resize(m_ranges.size());
+    auto &mark = m_marks[index];
+    if (!mark)
+        mark = RangeMark(m_document, m_ranges.at(index).first, m_ranges.at(index).second);
+    return *mark;
 }
 
-void MarkPrivate::update(int from, int charsRemoved, int charsAdded)
+bool LazyRangeMarks::update(const std::function<void(int &)> &updatePosition)
 {
-    Mark::updateMark(m_pos, from, charsRemoved, charsAdded);
+    bool hasUntracked = false;
+    for (qsizetype index = 0; index < m_ranges.size(); ++index) {
+        if (!m_marks.isEmpty() && m_marks.at(index))
+            continue;
+        auto &[start, end] = m_ranges[index];
+        updatePosition(start);
+        updatePosition(end);
+        hasUntracked = true;
+    }
+    return hasUntracked;
 }
 
-MarkPrivate::MarkPrivate(TextDocument *editor, int pos)
-    : QObject(nullptr) // Important to have nullptr here, MarkPrivate is managed by shared_ptrs in Mark, MarkPrivate can
-                       // deal with the editor being deleted.
-    , m_editor(editor)
-    , m_pos(pos)
+MarkHandle::MarkHandle(MarkTable *table, int position)
+    : m_table(table)
+    , m_id(table->add(position))
 {
-    Q_ASSERT(editor);
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &MarkPrivate::update);
+}
+
+MarkHandle::MarkHandle(const MarkHandle &other)
+    : m_table(other.m_table)
+    , m_id(other.m_id)
+{
+    if (m_table)
+        m_table->ref(m_id);
+}
+
+MarkHandle::MarkHandle(MarkHandle &&other) noexcept
+    : m_table(std::move(other.m_table))
+    , m_id(std::exchange(other.m_id, -1))
+{
+    other.m_table.clear();
+}
+
+MarkHandle &MarkHandle::operator=(const MarkHandle &other)
+{
+    MarkHandle(other).swap(*this);
+    return *this;
+}
+
+MarkHandle &MarkHandle::operator=(MarkHandle &&other) noexcept
+{
+    MarkHandle(std::move(other)).swap(*this);
+    return *this;
+}
+
+MarkHandle::~MarkHandle()
+{
+    if (m_table)
+        m_table->deref(m_id);
+}
+
+void MarkHandle::swap(MarkHandle &other) noexcept
+{
+    m_table.swap(other.m_table);
+    std::swap(m_id, other.m_id);
+}
+
+bool MarkHandle::isNull() const
+{
+    return m_id == -1;
+}
+
+int MarkHandle::position() const
+{
+    return m_table ? m_table->position(m_id) : -1;
+}
+
+TextDocument *MarkHandle::document() const
+{
+    return m_table ? m_table->document() : nullptr;
+}
+
+bool MarkHandle::operator==(const MarkHandle &other) const
+{
+    return m_table.data() == other.m_table.data() && m_id == other.m_id;
 }
 
 Mark::Mark(TextDocument *editor, int pos)
-    : d(std::make_shared<MarkPrivate>(editor, pos))
+    : m_handle(editor->markTable(), pos)
 {
 }
 
 bool Mark::isValid() const
 {
-    return d && d->isValid();
+    return document() && position() >= 0;
 }
 
 int Mark::position() const
 {
-    return d ? d->m_pos : -1;
+    return m_handle.position();
 }
 
 int Mark::line() const
 {
-    return d ? d->line() : -1;
+    if (!checkDocument())
+        return -1;
+
+    int line, column;
+    document()->convertPosition(position(), &line, &column);
+    return line;
 }
 
 int Mark::column() const
 {
-    return d ? d->column() : -1;
+    if (!checkDocument())
+        return -1;
+
+    int line, column;
+    document()->convertPosition(position(), &line, &column);
+    return column;
+}
+
+bool Mark::checkDocument() const
+{
+    if (m_handle.isNull())
+        return false;
+    if (!document()) {
+        spdlog::error("{}: - document does not exist anymore", FUNCTION_NAME);
+        return false;
+    }
+    return true;
 }
 
 QString Mark::toString() const
@@ -130,7 +450,7 @@ QString Mark::toString() const
 
 TextDocument *Mark::document() const
 {
-    return d ? d->m_editor : nullptr;
+    return m_handle.document();
 }
 
 /*!
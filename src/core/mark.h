@@ -11,16 +11,45 @@
 #pragma once
 
 #include <QObject>
-#include <memory>
+#include <QPointer>
 
 namespace Core {
 
+class MarkTable;
 class TextDocument;
 
-// Mark is shared_ptr to a MarkPrivate.
-// This way we can ensure that a Mark is easy to copy and move
-// around, whilst still ensuring the QObject that listens to the
-// changes of the TextDocument is correctly deleted both from QML and C++.
+// Handle on a position in the mark table of a TextDocument, see MarkTable.
+// The position is kept up to date in the table as long as a handle on it exists, copying a handle is cheap.
+class MarkHandle
+{
+public:
+    MarkHandle() = default;
+    MarkHandle(MarkTable *table, int position);
+
+    MarkHandle(const MarkHandle &other);
+    MarkHandle(MarkHandle &&other) noexcept;
+    MarkHandle &operator=(const MarkHandle &other);
+    MarkHandle &operator=(MarkHandle &&other) noexcept;
+    ~MarkHandle();
+
+    void swap(MarkHandle &other) noexcept;
+
+    // True if the handle was never given a position.
+    bool isNull() const;
+    // Returns -1 if the handle is null, or the document is deleted.
+    int position() const;
+    TextDocument *document() const;
+
+    bool operator==(const MarkHandle &other) const;
+
+private:
+    QPointer<MarkTable> m_table;
+    int m_id = -1;
+};
+
+// Mark is a handle on a position in the mark table of the TextDocument.
+// This way a Mark is easy to copy and move around, both from QML and C++, and all marks of a document are updated at
+// once when the text changes.
 class Mark
 {
     Q_GADGET
@@ -53,7 +82,9 @@ public:
     Q_INVOKABLE void restore() const;
 
 private:
-    std::shared_ptr<class MarkPrivate> d = nullptr;
+    bool checkDocument() const;
+
+    MarkHandle m_handle;
 
     friend TextDocument;
 };
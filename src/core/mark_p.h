@@ -10,34 +10,135 @@
 
 #pragma once
 
+#include "rangemark.h"
+
+#include <QList>
 #include <QObject>
 #include <QPointer>
 
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
 namespace Core {
 
+class LazyRangeMarks;
 class TextDocument;
 
-class MarkPrivate : public QObject
+// Positions of all the marks (and range marks) of a TextDocument.
+// A single connection updates all of them when the text changes, instead of one QObject and connection per mark.
+//
+// Edits never change the order of the marks (see Mark::updateMark), so the positions are kept sorted: a position is
+// its base value plus the shifts of all edits done before it, summed in a Fenwick tree. An edit is then a binary
+// search and one shift, plus collapsing the marks inside the removed text.
+// New marks are added to a small unsorted list first, merged with the sorted ones once it's full.
+class MarkTable : public QObject
 {
     Q_OBJECT
 
 public:
-    // Unfortunately this needs to be public, as otherwise std::make_shared can't access it
-    explicit MarkPrivate(TextDocument *editor, int pos);
+    explicit MarkTable(TextDocument *document);
 
-private:
-    bool isValid() const;
+    TextDocument *document() const;
+
+    // Returns the id of a new mark at the given position, with one reference.
+    int add(int position);
+    void ref(int id);
+    // The mark is released once there are no references left.
+    void deref(int id);
+
+    int position(int id) const;
 
-    int line() const;
-    int column() const;
+    // The positions of the ranges are updated on each edit, until they are used, see LazyRangeMarks.
+    void addLazy(const std::shared_ptr<LazyRangeMarks> &ranges);
 
-    bool checkEditor() const;
+    // Replacement of the text between start and end by `length` characters.
+    struct Replacement
+    {
+        int start;
+        int end;
+        int length;
+    };
+    // The next change of the document is made of all these replacements (sorted, positions before the change), see
+    // TextDocument::replaceAll. The marks are updated as if each replacement was a separate edit, instead of
+    // collapsing all marks inside the changed text.
+    void setReplacements(std::vector<Replacement> &&replacements);
 
+private:
     void update(int from, int charsRemoved, int charsAdded);
+    void updateReplacements();
+    // New position of a mark after the replacements, same as calling Mark::updateMark for each of them.
+    int replacedPosition(int position) const;
+    void updateLazy(const std::function<void(int &)> &updatePosition);
+
+    int sortedPosition(int index) const;
+    // Sum of the shifts up to the sorted index.
+    int shift(int index) const;
+    // Shifts all sorted positions from the index.
+    void addShift(int index, int delta);
+    // Returns the first sorted index with a position >= the given one.
+    int lowerBound(int position) const;
+    // Merges the pending marks with the sorted ones, and drops the released ones.
+    void merge();
+
+    struct Slot
+    {
+        // Index in the sorted marks, -1 for a pending mark.
+        int index = -1;
+        // Only for pending marks, the sorted ones are in m_base and m_shifts.
+        int position = -1;
+        int refs = 0;
+    };
+
+    // Bounds the cost of an edit, as the pending marks are updated one by one.
+    static constexpr size_t MaxPending = 1024;
+
+    TextDocument *const m_document;
+    std::vector<Slot> m_slots;
+    std::vector<int> m_freeSlots;
+    std::vector<int> m_pending;
+    // Slot id of each sorted mark, -1 once released.
+    std::vector<int> m_ids;
+    std::vector<int> m_base;
+    // Fenwick tree, 1-based.
+    std::vector<int> m_shifts;
+    size_t m_released = 0;
+    std::vector<std::weak_ptr<LazyRangeMarks>> m_lazy;
+    size_t m_lazyLimit = MaxPending;
+    std::vector<Replacement> m_replacements;
+    // Shift of the positions after each replacement, with all the previous ones.
+    std::vector<int> m_replacementShifts;
+};
+
+// Ranges which are only tracked once used, until then they are plain positions.
+// Most query matches are read once, or not at all (e.g. when only some of the captures are used), so tracking all
+// of their captures would be wasted. Cached matches can also stay alive across many edits (e.g. the symbol table),
+// so the positions not used yet are shifted in place by each edit: no range mark is created until one is asked for.
+class LazyRangeMarks
+{
+public:
+    static std::shared_ptr<LazyRangeMarks> create(TextDocument *document, QList<std::pair<int, int>> &&ranges);
+
+    qsizetype size() const;
+    // Current start and end of the range, without creating a range mark.
+    int start(qsizetype index) const;
+    int end(qsizetype index) const;
+    TextDocument *document() const;
+
+    RangeMark at(qsizetype index);
+
+private:
+    LazyRangeMarks(TextDocument *document, QList<std::pair<int, int>> &&ranges);
+
+    friend MarkTable;
+    // Updates the positions of the ranges not used yet for the edit. Returns false if all ranges are used.
+    bool update(const std::function<void(int &)> &updatePosition);
 
-    QPointer<TextDocument> m_editor;
-    int m_pos = -1;
-    friend class Mark;
+    QPointer<TextDocument> m_document;
+    QList<std::pair<int, int>> m_ranges;
+    // Empty until one of the ranges is used.
+    QList<std::optional<RangeMark>> m_marks;
 };
 
 } // namespace Core
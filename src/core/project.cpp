@@ -28,10 +28,10 @@
 #include "utils/log.h"
 
 #include <QDir>
-#include <QDirIterator>
 #include <QFileInfo>
 #include <QMetaEnum>
 #include <QProcess>
+#include <QSet>
 #include <QStandardPaths>
 #include <algorithm>
 #include <kdalgorithms.h>
@@ -63,6 +63,7 @@ namespace Core {
 
 Project::Project(QObject *parent)
     : QObject(parent)
+    , m_fileIndex(new FileIndex(this))
 {
     Q_ASSERT(m_instance == nullptr);
     m_instance = this;
@@ -104,6 +105,7 @@ bool Project::setRoot(const QString &newRoot)
 
     m_root = dir.absolutePath();
     Settings::instance()->loadProjectSettings(m_root);
+    m_fileIndex->setRoot(m_root, DEFAULT_VALUE(QStringList, ProjectIgnore));
     for (auto client : m_lspClients | std::views::values)
         client->openProject(m_root);
 
@@ -111,6 +113,16 @@ bool Project::setRoot(const QString &newRoot)
     return true;
 }
 
+// The index only stores the paths relative to the root.
+static QStringList withPathType(QStringList files, const QString &root, Project::PathType type)
+{
+    if (type == Project::FullPath) {
+        for (auto &file : files)
+            file = root + '/' + file;
+    }
+    return files;
+}
+
 /*!
  * \qmlmethod array<string> Project::allFiles(PathType type = RelativeToRoot)
  * Returns all files in the current project.
@@ -118,6 +130,9 @@ bool Project::setRoot(const QString &newRoot)
  *
  * - `Project.FullPath`
  * - `Project.RelativeToRoot`
+ *
+ * Files and directories matching one of the `/project/ignore` patterns of the settings are skipped, by default the
+ * hidden ones.
  */
 QStringList Project::allFiles(PathType type) const
 {
@@ -126,17 +141,7 @@ QStringList Project::allFiles(PathType type) const
 
     LOG(type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile())
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
-    }
-    std::ranges::sort(result);
-    return result;
+    return withPathType(m_fileIndex->files(), m_root, type);
 }
 
 /*!
@@ -154,17 +159,14 @@ QStringList Project::allFilesWithExtension(const QString &extension, PathType ty
 
     LOG(extension, type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile() && fi.suffix() == extension)
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
+    auto files = m_fileIndex->filesWithSuffix(extension);
+    // The index is case insensitive, not this method
+    if (!extension.isEmpty()) {
+        files.removeIf([suffix = '.' + extension](const QString &file) {
+            return !file.endsWith(suffix);
+        });
     }
-    std::ranges::sort(result);
-    return result;
+    return withPathType(files, m_root, type);
 }
 
 /*!
@@ -182,17 +184,31 @@ QStringList Project::allFilesWithExtensions(const QStringList &extensions, PathT
 
     LOG(extensions, type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile() && extensions.contains(fi.suffix(), Qt::CaseInsensitive))
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
+    QStringList files;
+    QSet<QString> suffixes;
+    for (const auto &extension : extensions) {
+        const auto suffix = extension.toLower();
+        if (suffixes.contains(suffix))
+            continue;
+        suffixes.insert(suffix);
+        files.append(m_fileIndex->filesWithSuffix(suffix));
     }
-    std::ranges::sort(result);
-    return result;
+    if (suffixes.size() > 1)
+        std::ranges::sort(files);
+    return withPathType(files, m_root, type);
+}
+
+QStringList Project::allFilesWithName(const QString &fileName, PathType type) const
+{
+    if (m_root.isEmpty())
+        return {};
+    return withPathType(m_fileIndex->filesWithName(fileName), m_root, type);
+}
+
+void Project::updateFiles(const QStringList &fileNames)
+{
+    for (const auto &fileName : fileNames)
+        m_fileIndex->invalidate(fileName);
 }
 
 static Document *createDocument(const QString &suffix)
@@ -277,16 +293,18 @@ Document *Project::getDocument(QString fileName, bool moveToBack)
     else
         fileName = fi.absoluteFilePath();
 
-    auto findIt = std::ranges::find_if(m_documents, [fileName](auto document) {
-        return document->fileName() == fileName;
-    });
-
-    Document *doc = nullptr;
+    Document *doc = m_documentIndex.value(fileName);
+    // Closing a document clears its file name, without any signal.
+    if (doc && doc->fileName() != fileName) {
+        m_documentIndex.remove(fileName);
+        doc = nullptr;
+    }
 
-    if (findIt != m_documents.end()) {
-        doc = *findIt;
-        if (moveToBack)
-            std::rotate(findIt, findIt + 1, m_documents.end());
+    if (doc) {
+        if (moveToBack) {
+            auto it = std::ranges::find(m_documents, doc);
+            std::rotate(it, it + 1, m_documents.end());
+        }
     } else {
         doc = createDocument(fi.suffix());
         if (doc) {
@@ -294,16 +312,50 @@ Document *Project::getDocument(QString fileName, bool moveToBack)
                 codeDocument->setLspClient(getClient(doc->type()));
             doc->setParent(this);
             doc->load(fileName);
-            m_documents.push_back(doc);
+            addDocument(doc);
             emit documentsChanged();
         } else {
             spdlog::error("{}: {} - unknown document type", FUNCTION_NAME, fi.suffix());
             return nullptr;
         }
     }
+    useDocument(doc);
     return doc;
 }
 
+void Project::addDocument(Document *document)
+{
+    m_documents.push_back(document);
+    m_documentIndex.insert(document->fileName(), document);
+    connect(document, &Document::fileNameChanged, this, [this, document]() {
+        m_documentIndex.removeIf([document](const auto &it) {
+            return it.value() == document;
+        });
+        if (!document->fileName().isEmpty()) {
+            m_documentIndex.insert(document->fileName(), document);
+            m_fileIndex->invalidate(document->fileName());
+        }
+    });
+}
+
+void Project::useDocument(Document *document)
+{
+    auto codeDocument = qobject_cast<CodeDocument *>(document);
+    const int maxSyntaxTrees = DEFAULT_VALUE(int, TreeSitterMaxSyntaxTrees);
+    if (!codeDocument || maxSyntaxTrees <= 0)
+        return;
+
+    // Scripts going through all the files of a project would otherwise keep all their syntax trees in memory.
+    // The documents themselves are kept, as scripts may still use them: their trees are parsed again if needed.
+    m_parsedDocuments.removeOne(codeDocument);
+    m_parsedDocuments.push_back(codeDocument);
+    while (m_parsedDocuments.size() > maxSyntaxTrees) {
+        auto leastRecentlyUsed = m_parsedDocuments.takeFirst();
+        if (leastRecentlyUsed && leastRecentlyUsed.data() != m_current)
+            leastRecentlyUsed->releaseSyntaxTree();
+    }
+}
+
 /*!
  * \qmlmethod Document Project::get(string fileName)
  * Gets the document for the given `fileName`. If the document is not opened yet, open it. If the document
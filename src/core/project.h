@@ -12,7 +12,9 @@
 
 #include "document.h"
 
+#include <QHash>
 #include <QObject>
+#include <QPointer>
 #include <unordered_map>
 
 namespace Lsp {
@@ -21,6 +23,9 @@ class Client;
 
 namespace Core {
 
+class CodeDocument;
+class FileIndex;
+
 class Project : public QObject
 {
     Q_OBJECT
@@ -53,6 +58,10 @@ public:
                                                   Core::Project::PathType type = RelativeToRoot);
     Q_INVOKABLE QStringList allFilesWithExtensions(const QStringList &extensions,
                                                    Core::Project::PathType type = RelativeToRoot);
+    // Files with the given name, in any directory of the project (case insensitive).
+    QStringList allFilesWithName(const QString &fileName, Core::Project::PathType type = RelativeToRoot) const;
+    // Files created or removed by Knut, the file system watcher only notifies them once back in the event loop.
+    void updateFiles(const QStringList &fileNames);
     Q_INVOKABLE QVariantList findInFiles(const QString &pattern) const;
     Q_INVOKABLE bool isFindInFilesAvailable() const;
 
@@ -73,13 +82,21 @@ private:
     explicit Project(QObject *parent = nullptr);
 
     Core::Document *getDocument(QString fileName, bool moveToBack = false);
+    void addDocument(Document *document);
+    // Only the most recently used documents keep their syntax tree, see Settings::TreeSitterMaxSyntaxTrees.
+    void useDocument(Document *document);
     Lsp::Client *getClient(Document::Type type);
 
 private:
     inline static Project *m_instance = nullptr;
 
     QString m_root;
+    FileIndex *const m_fileIndex;
     QList<Document *> m_documents;
+    // Documents by file name, to find them without going through all of them.
+    QHash<QString, Document *> m_documentIndex;
+    // Most recently used last
+    QList<QPointer<CodeDocument>> m_parsedDocuments;
     Core::Document *m_current = nullptr;
     std::unordered_map<Core::Document::Type, Lsp::Client *> m_lspClients;
 };
@@ -0,0 +1,304 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "project_p.h"
+#include "utils/log.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutex>
+#include <QPromise>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+
+namespace Core {
+
+static QString joinPath(const QString &path, const QString &name)
+{
+    return path.isEmpty() ? name : path + '/' + name;
+}
+
+static bool isIgnored(const QList<QRegularExpression> &ignorePatterns, const QString &name, const QString &path)
+{
+    return std::ranges::any_of(ignorePatterns, [&](const QRegularExpression &pattern) {
+        return pattern.match(name).hasMatch() || pattern.match(path).hasMatch();
+    });
+}
+
+// Shared with the worker threads, until all directories are listed.
+struct FileIndex::Scan
+{
+    QString root;
+    QList<QRegularExpression> ignorePatterns;
+    // The directories are only watched once all are listed, see adoptScan.
+    QDateTime startTime;
+    QPromise<void> promise;
+    // Directories being listed, or waiting for a worker thread.
+    std::atomic<int> pending = 1;
+    std::atomic<bool> canceled = false;
+    QMutex mutex;
+    QHash<QString, Directory> directories;
+};
+
+FileIndex::FileIndex(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+{
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, [this](const QString &path) {
+        m_changedDirectories.insert(relativePath(path));
+    });
+}
+
+FileIndex::~FileIndex()
+{
+    if (m_scan)
+        m_scan->canceled = true;
+}
+
+void FileIndex::setRoot(const QString &root, const QStringList &ignorePatterns)
+{
+    if (m_scan)
+        m_scan->canceled = true;
+    if (const auto paths = m_watcher->directories(); !paths.isEmpty())
+        m_watcher->removePaths(paths);
+
+    m_root = root;
+    m_ignorePatterns.clear();
+    for (const auto &pattern : ignorePatterns)
+        m_ignorePatterns.push_back(QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern)));
+    m_directories.clear();
+    m_changedDirectories.clear();
+    m_files.clear();
+    m_filesBySuffix.clear();
+    m_filesByName.clear();
+    m_needsRebuild = false;
+
+    m_scan = std::make_shared<Scan>();
+    m_scan->root = m_root;
+    m_scan->ignorePatterns = m_ignorePatterns;
+    m_scan->startTime = QDateTime::currentDateTime();
+    m_scan->promise.start();
+    m_scanFuture = m_scan->promise.future();
+    QThreadPool::globalInstance()->start([scan = m_scan]() {
+        scanDirectory(scan, {});
+    });
+
+    // Runs in the GUI thread, to start watching the directories without waiting for the index to be used.
+    // The scan is not captured: it owns the promise, and so this continuation.
+    m_scanFuture.then(this, [this, scan = m_scan.get()]() {
+        if (m_scan.get() == scan)
+            adoptScan();
+    });
+}
+
+const QStringList &FileIndex::files()
+{
+    update();
+    return m_files;
+}
+
+QStringList FileIndex::filesWithSuffix(const QString &suffix)
+{
+    update();
+    return m_filesBySuffix.value(suffix.toLower());
+}
+
+QStringList FileIndex::filesWithName(const QString &fileName)
+{
+    update();
+    return m_filesByName.value(fileName.toLower());
+}
+
+void FileIndex::invalidate(const QString &fileName)
+{
+    if (m_root.isEmpty())
+        return;
+
+    QString path = relativePath(QFileInfo(fileName).absolutePath());
+    if (path == ".." || path.startsWith("../"))
+        return;
+    // New directories are found by listing their first known parent again.
+    while (!path.isEmpty() && !m_directories.contains(path))
+        path = path.section('/', 0, -2);
+    m_changedDirectories.insert(path);
+}
+
+FileIndex::Directory FileIndex::listDirectory(const QString &root, const QString &path,
+                                              const QList<QRegularExpression> &ignorePatterns)
+{
+    Directory directory;
+    QDirIterator it(joinPath(root, path), QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const auto fi = it.fileInfo();
+        const QString name = fi.fileName();
+        if (isIgnored(ignorePatterns, name, joinPath(path, name)))
+            continue;
+        // Same as QDirIterator::Subdirectories, symbolic links to directories are not followed.
+        if (fi.isDir()) {
+            if (!fi.isSymLink())
+                directory.directories.push_back(name);
+        } else if (fi.isFile()) {
+            directory.files.push_back(name);
+        }
+    }
+    return directory;
+}
+
+void FileIndex::scanDirectory(const std::shared_ptr<Scan> &scan, const QString &path)
+{
+    auto directory = listDirectory(scan->root, path, scan->ignorePatterns);
+
+    // Each subdirectory is a separate task, so that a large subtree is shared between all worker threads.
+    if (!scan->canceled) {
+        for (const auto &name : std::as_const(directory.directories)) {
+            ++scan->pending;
+            QThreadPool::globalInstance()->start([scan, subPath = joinPath(path, name)]() {
+                scanDirectory(scan, subPath);
+            });
+        }
+    }
+
+    {
+        QMutexLocker locker(&scan->mutex);
+        scan->directories.insert(path, std::move(directory));
+    }
+    if (--scan->pending == 0)
+        scan->promise.finish();
+}
+
+void FileIndex::adoptScan()
+{
+    // Already done by update, when waiting for the scan to finish.
+    if (!m_scan || !m_scanFuture.isFinished())
+        return;
+
+    m_directories = std::move(m_scan->directories);
+    // Some slack, for file systems storing the modification times with a coarse resolution.
+    const auto startTime = m_scan->startTime.addSecs(-2);
+    m_scan.reset();
+    m_scanFuture = {};
+
+    QStringList paths;
+    paths.reserve(m_directories.size());
+    for (auto it = m_directories.cbegin(); it != m_directories.cend(); ++it)
+        paths.push_back(absolutePath(it.key()));
+    const auto failed = m_watcher->addPaths(paths);
+    if (!failed.isEmpty())
+        spdlog::warn("{}: Unable to watch {} directories, the project files may be outdated", FUNCTION_NAME,
+                     failed.size());
+
+    // The watcher can't be used from the worker threads, so the directories were listed before being watched: the
+    // ones modified since the scan started are listed again, in case they changed in between.
+    for (const auto &path : std::as_const(paths)) {
+        if (QFileInfo(path).lastModified() >= startTime)
+            m_changedDirectories.insert(relativePath(path));
+    }
+    m_needsRebuild = true;
+}
+
+void FileIndex::update()
+{
+    if (m_scan) {
+        m_scanFuture.waitForFinished();
+        adoptScan();
+    }
+
+    if (!m_changedDirectories.isEmpty()) {
+        QStringList changedDirectories(m_changedDirectories.cbegin(), m_changedDirectories.cend());
+        m_changedDirectories.clear();
+        // Parents first, their changed subdirectories may be removed with them.
+        std::ranges::sort(changedDirectories);
+
+        for (const auto &path : std::as_const(changedDirectories)) {
+            if (!m_directories.contains(path))
+                continue;
+            if (!QFileInfo(absolutePath(path)).isDir()) {
+                removeDirectory(path);
+                continue;
+            }
+
+            auto directory = listDirectory(m_root, path, m_ignorePatterns);
+            const auto oldDirectories = m_directories.value(path).directories;
+            const QSet<QString> oldNames(oldDirectories.cbegin(), oldDirectories.cend());
+            const QSet<QString> newNames(directory.directories.cbegin(), directory.directories.cend());
+            for (const auto &name : oldNames) {
+                if (!newNames.contains(name))
+                    removeDirectory(joinPath(path, name));
+            }
+            for (const auto &name : newNames) {
+                if (!oldNames.contains(name))
+                    addDirectory(joinPath(path, name));
+            }
+            m_directories.insert(path, std::move(directory));
+        }
+        m_needsRebuild = true;
+    }
+
+    if (m_needsRebuild)
+        rebuild();
+}
+
+void FileIndex::addDirectory(const QString &path)
+{
+    // Watched first, so a change done while listing it isn't missed.
+    m_watcher->addPath(absolutePath(path));
+    auto directory = listDirectory(m_root, path, m_ignorePatterns);
+    for (const auto &name : std::as_const(directory.directories))
+        addDirectory(joinPath(path, name));
+    m_directories.insert(path, std::move(directory));
+}
+
+void FileIndex::removeDirectory(const QString &path)
+{
+    const auto directory = m_directories.take(path);
+    m_watcher->removePath(absolutePath(path));
+    for (const auto &name : directory.directories)
+        removeDirectory(joinPath(path, name));
+}
+
+void FileIndex::rebuild()
+{
+    m_files.clear();
+    m_filesBySuffix.clear();
+    m_filesByName.clear();
+
+    for (auto it = m_directories.cbegin(); it != m_directories.cend(); ++it) {
+        for (const auto &name : it->files)
+            m_files.push_back(joinPath(it.key(), name));
+    }
+    std::ranges::sort(m_files);
+
+    // Going through the sorted files keeps the lookup tables sorted too.
+    for (const auto &file : std::as_const(m_files)) {
+        const auto name = file.mid(file.lastIndexOf('/') + 1);
+        const auto dot = name.lastIndexOf('.');
+        m_filesBySuffix[dot == -1 ? QString() : name.mid(dot + 1).toLower()].push_back(file);
+        m_filesByName[name.toLower()].push_back(file);
+    }
+    m_needsRebuild = false;
+}
+
+QString FileIndex::absolutePath(const QString &path) const
+{
+    return joinPath(m_root, path);
+}
+
+QString FileIndex::relativePath(const QString &path) const
+{
+    const auto relativePath = QDir(m_root).relativeFilePath(path);
+    return relativePath == "." ? QString() : relativePath;
+}
+
+} // namespace Core
@@ -13,6 +13,16 @@
 #include "document.h"
 #include "utils/json.h"
 
+#include <QFuture>
+#include <QHash>
+#include <QObject>
+#include <QRegularExpression>
+#include <QSet>
+#include <QStringList>
+#include <memory>
+
+class QFileSystemWatcher;
+
 namespace Core {
 
 //! Store settings relative to a LSP server
@@ -25,4 +35,65 @@ struct LspServer
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LspServer, type, program, arguments);
 
+// Index of all the files of a project, see Project::allFiles.
+// The directories are listed in parallel in the global thread pool when the root is set, the first use of the index
+// waits for them. Afterwards, all directories are watched (the ones modified during the scan are listed again): a
+// changed directory is listed again the next time the index is used, instead of walking the whole project.
+class FileIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileIndex(QObject *parent = nullptr);
+    ~FileIndex() override;
+
+    // The patterns are wildcards, matched against the names and the paths (relative to the root) of the files and
+    // directories to skip.
+    void setRoot(const QString &root, const QStringList &ignorePatterns);
+
+    // All paths are relative to the root, and sorted.
+    const QStringList &files();
+    // Both are case insensitive.
+    QStringList filesWithSuffix(const QString &suffix);
+    QStringList filesWithName(const QString &fileName);
+
+    // For changes not notified yet by the file system watcher, which only does it once back in the event loop.
+    void invalidate(const QString &fileName);
+
+private:
+    struct Directory
+    {
+        // Names of the files and subdirectories
+        QStringList files;
+        QStringList directories;
+    };
+    struct Scan;
+
+    static Directory listDirectory(const QString &root, const QString &path,
+                                   const QList<QRegularExpression> &ignorePatterns);
+    static void scanDirectory(const std::shared_ptr<Scan> &scan, const QString &path);
+    void adoptScan();
+    void update();
+    void addDirectory(const QString &path);
+    void removeDirectory(const QString &path);
+    void rebuild();
+
+    QString absolutePath(const QString &path) const;
+    QString relativePath(const QString &path) const;
+
+    QString m_root;
+    QList<QRegularExpression> m_ignorePatterns;
+    QFileSystemWatcher *const m_watcher;
+    std::shared_ptr<Scan> m_scan;
+    QFuture<void> m_scanFuture;
+    // By path relative to the root, empty for the root itself.
+    QHash<QString, Directory> m_directories;
+    QSet<QString> m_changedDirectories;
+    bool m_needsRebuild = false;
+    QStringList m_files;
+    // By lower case suffix or file name, the paths are sorted.
+    QHash<QString, QStringList> m_filesBySuffix;
+    QHash<QString, QStringList> m_filesByName;
+};
+
 } // namespace Core
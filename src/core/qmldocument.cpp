@@ -15,18 +15,17 @@
 namespace {
 using namespace Core;
 
-auto queryUIObjectSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+SymbolQuery uiObjectSymbolQuery()
 {
-    const auto queryString = QString(R"EOF(
-        (ui_object_definition type_name : (_) @name @selectionRange) @range
-    )EOF");
-    auto uiObjectDefinitions = document->query(queryString);
-    auto objectsToSymbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Object);
+    auto objectKind = [](const QueryMatch &) {
+        return Symbol::Kind::Object;
     };
-    return kdalgorithms::transformed<QList<Symbol *>>(uiObjectDefinitions, objectsToSymbol);
+    return {.query = R"EOF(
+                (ui_object_definition type_name : (_) @name @selectionRange) @range
+            )EOF",
+            .symbolKind = objectKind};
 }
-auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+SymbolQuery functionSymbolQuery()
 {
     const auto queryString = QString(R"EOF(
         (function_declaration
@@ -37,16 +36,15 @@ auto queryFunctionSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
         body: (_) @body
         ) @range
     )EOF");
-    auto functions = document->query(queryString);
 
-    auto function_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Function);
+    auto function_kind = [](const QueryMatch &) {
+        return Symbol::Kind::Function;
     };
 
-    return kdalgorithms::transformed<QList<Symbol *>>(functions, function_to_symbol);
+    return {.query = queryString, .symbolKind = function_kind};
 }
 
-auto queryPropertySymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+SymbolQuery propertySymbolQuery()
 {
     const auto queryString = QString(R"EOF(
         (ui_binding
@@ -55,22 +53,18 @@ auto queryPropertySymbols(CodeDocument *const document) -> QList<Core::Symbol *>
         @value) @range
 
     )EOF");
-    auto members = document->query(queryString);
 
-    auto member_to_symbol = [document](const QueryMatch &match) {
-        return Symbol::makeSymbol(document, match, Symbol::Kind::Field);
+    auto member_kind = [](const QueryMatch &) {
+        return Symbol::Kind::Field;
     };
 
-    return kdalgorithms::transformed<QList<Symbol *>>(members, member_to_symbol);
+    return {.query = queryString, .symbolKind = member_kind};
 }
 
-auto queryAllSymbols(CodeDocument *const document) -> QList<Core::Symbol *>
+// All symbols are found with a single query, see TreeSitterHelper::setSymbolQueries.
+QList<SymbolQuery> allSymbolQueries()
 {
-    auto symbols = ::queryUIObjectSymbols(document);
-    symbols.append(::queryFunctionSymbols(document));
-    symbols.append(::queryPropertySymbols(document));
-
-    return symbols;
+    return {uiObjectSymbolQuery(), functionSymbolQuery(), propertySymbolQuery()};
 }
 
 }
@@ -80,7 +74,7 @@ namespace Core {
 QmlDocument::QmlDocument(QObject *parent)
     : CodeDocument(Type::Qml, parent)
 {
-    helper()->querySymbols = ::queryAllSymbols;
+    helper()->setSymbolQueries(::allSymbolQueries());
 }
 
 QmlDocument::~QmlDocument() = default;
@@ -10,12 +10,13 @@
 
 #include "querymatch.h"
 #include "codedocument.h"
+#include "mark_p.h"
 #include "rangemark.h"
 #include "textdocument.h"
 #include "utils/log.h"
 
 #include <QJSEngine>
-#include <kdalgorithms.h>
+#include <limits>
 #include <treesitter/query.h>
 
 namespace Core {
@@ -83,26 +84,64 @@ QString QueryCapture::toString() const
  */
 
 QueryMatch::QueryMatch(TextDocument &document, const treesitter::QueryMatch &match)
+    : m_query(match.query())
 {
     const auto captures = match.captures();
+    m_ids.reserve(captures.size());
+    QList<std::pair<int, int>> ranges;
+    ranges.reserve(captures.size());
     for (const auto &capture : captures) {
-        const auto name = match.query()->captureAt(capture.id).name;
+        m_ids.push_back(capture.id);
+        ranges.emplace_back(capture.node.startPosition(), capture.node.endPosition());
+    }
+    m_ranges = LazyRangeMarks::create(&document, std::move(ranges));
+}
 
-        const auto &node = capture.node;
-        const auto range = document.createRangeMark(node.startPosition(), node.endPosition());
+std::optional<uint32_t> QueryMatch::captureId(const QString &name) const
+{
+    return m_query ? m_query->captureId(name) : std::nullopt;
+}
 
-        m_captures.emplace_back(QueryCapture {.name = name, .range = range});
+QList<QueryCapture> QueryMatch::captures() const
+{
+    QList<QueryCapture> result;
+    result.reserve(m_ids.size());
+    for (qsizetype index = 0; index < m_ids.size(); ++index) {
+        const auto name = m_query->captureAt(m_ids.at(index)).name;
+        result.emplace_back(QueryCapture {.name = name, .range = m_ranges->at(index)});
     }
+    return result;
 }
 
-const QList<QueryCapture> &QueryMatch::captures() const
+bool QueryMatch::isEmpty() const
 {
-    return m_captures;
+    return m_ids.isEmpty();
 }
 
-bool QueryMatch::isEmpty() const
+std::pair<int, int> QueryMatch::span() const
 {
-    return m_captures.isEmpty();
+    if (isEmpty())
+        return {-1, -1};
+
+    int start = std::numeric_limits<int>::max();
+    int end = -1;
+    for (qsizetype index = 0; index < m_ids.size(); ++index) {
+        start = std::min(start, m_ranges->start(index));
+        end = std::max(end, m_ranges->end(index));
+    }
+    return {start, end};
+}
+
+std::pair<int, int> QueryMatch::span(const QString &name) const
+{
+    const auto id = captureId(name);
+    if (!id)
+        return {-1, -1};
+
+    const auto index = m_ids.indexOf(*id);
+    if (index < 0)
+        return {-1, -1};
+    return {m_ranges->start(index), m_ranges->end(index)};
 }
 
 /*!
@@ -112,10 +151,13 @@ bool QueryMatch::isEmpty() const
 Core::RangeMarkList QueryMatch::getAll(const QString &name) const
 {
     Core::RangeMarkList result;
+    const auto id = captureId(name);
+    if (!id)
+        return result;
 
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            result.emplace_back(capture.range);
+    for (qsizetype index = 0; index < m_ids.size(); ++index) {
+        if (m_ids.at(index) == *id)
+            result.emplace_back(m_ranges->at(index));
     }
 
     return result;
@@ -127,13 +169,16 @@ Core::RangeMarkList QueryMatch::getAll(const QString &name) const
  */
 Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto toRange = [](const QueryCapture &capture) {
-        return capture.range;
-    };
-    return kdalgorithms::filtered_transformed(m_captures, toRange, captureMatch);
+    Core::RangeMarkList result;
+    const auto id = captureId(name);
+    if (!id || !range.isValid() || range.document() != m_ranges->document())
+        return result;
+
+    for (qsizetype index = 0; index < m_ids.size(); ++index) {
+        if (m_ids.at(index) == *id && range.start() <= m_ranges->start(index) && m_ranges->end(index) <= range.end())
+            result.emplace_back(m_ranges->at(index));
+    }
+    return result;
 }
 
 /*!
@@ -154,12 +199,12 @@ Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::R
  */
 RangeMark QueryMatch::get(const QString &name) const
 {
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            return capture.range;
-    }
+    const auto id = captureId(name);
+    if (!id)
+        return RangeMark();
 
-    return RangeMark();
+    const auto index = m_ids.indexOf(*id);
+    return index >= 0 ? m_ranges->at(index) : RangeMark();
 }
 
 /*!
@@ -168,12 +213,14 @@ RangeMark QueryMatch::get(const QString &name) const
  */
 Core::RangeMark QueryMatch::getInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto result = kdalgorithms::find_if(m_captures, captureMatch);
-    if (result)
-        return result->range;
+    const auto id = captureId(name);
+    if (!id || !range.isValid() || range.document() != m_ranges->document())
+        return {};
+
+    for (qsizetype index = 0; index < m_ids.size(); ++index) {
+        if (m_ids.at(index) == *id && range.start() <= m_ranges->start(index) && m_ranges->end(index) <= range.end())
+            return m_ranges->at(index);
+    }
     return {};
 }
 
@@ -183,12 +230,24 @@ Core::RangeMark QueryMatch::getInRange(const QString &name, const Core::RangeMar
  */
 RangeMark QueryMatch::getAllJoined(const QString &name) const
 {
-    auto ranges = getAll(name);
+    const auto id = captureId(name);
+    if (!id || !m_ranges->document())
+        return RangeMark();
+
+    // Join the positions, instead of creating a range mark for each of the captures.
+    int start = std::numeric_limits<int>::max();
+    int end = -1;
+    for (qsizetype index = 0; index < m_ids.size(); ++index) {
+        if (m_ids.at(index) == *id) {
+            start = std::min(start, m_ranges->start(index));
+            end = std::max(end, m_ranges->end(index));
+        }
+    }
 
-    if (ranges.isEmpty())
+    if (end == -1)
         return RangeMark();
 
-    return kdalgorithms::accumulate(ranges, &RangeMark::join, ranges.at(0));
+    return RangeMark(m_ranges->document(), start, end);
 }
 
 /**
@@ -211,28 +270,30 @@ RangeMark QueryMatch::getAllJoined(const QString &name) const
  * `);
  * let return_statements = function.queryIn("body", "(return_statement) @return");
  * ```
+ *
+ * The limits of the query are the ones of `CodeDocument::query`, taken from the `/treesitter/query` settings.
  * \sa CodeDocument::query
  */
 Core::QueryMatchList QueryMatch::queryIn(const QString &capture, const QString &query) const
 {
-    Core::QueryMatchList result;
-
     const auto ranges = getAll(capture);
-    for (const auto &range : ranges) {
-        auto document = qobject_cast<CodeDocument *>(range.document());
-        if (document) {
-            result.append(document->queryInRange(range, query));
-        } else {
-            spdlog::warn("{}: RangeMark is not backed by CodeDocument!", FUNCTION_NAME);
-        }
+    if (ranges.isEmpty()) {
+        return {};
     }
 
-    return result;
+    // All captures of a match are in the same document, so the query only needs to be run once for all ranges.
+    auto document = qobject_cast<CodeDocument *>(ranges.first().document());
+    if (!document) {
+        spdlog::warn("{}: RangeMark is not backed by CodeDocument!", FUNCTION_NAME);
+        return {};
+    }
+
+    return document->queryInRanges(ranges, query, CodeDocument::queryLimits());
 }
 
 QString QueryMatch::toString() const
 {
-    return QString("QueryMatch{%1}").arg(m_captures.size());
+    return QString("QueryMatch{%1}").arg(m_ids.size());
 }
 
 } // namespace Core
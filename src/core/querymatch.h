@@ -13,13 +13,17 @@
 #include "rangemark.h"
 
 #include <QObject>
+#include <memory>
+#include <optional>
 
 namespace treesitter {
+class Query;
 class QueryMatch;
 }
 
 namespace Core {
 
+class LazyRangeMarks;
 class TextDocument;
 
 class QueryCapture
@@ -48,8 +52,12 @@ public:
     QueryMatch() = default;
     QueryMatch(TextDocument &document, const treesitter::QueryMatch &match);
 
-    const QList<QueryCapture> &captures() const;
+    QList<QueryCapture> captures() const;
     bool isEmpty() const;
+    // Start and end of all the captures together (the end is excluded), or {-1, -1} for an empty match.
+    std::pair<int, int> span() const;
+    // Start and end of the first capture with this name, or {-1, -1}, without creating a range mark for it.
+    std::pair<int, int> span(const QString &name) const;
 
     // Access to captures
     Q_INVOKABLE Core::RangeMark get(const QString &name) const;
@@ -75,7 +83,13 @@ public:
     Q_INVOKABLE QString toString() const;
 
 private:
-    QList<QueryCapture> m_captures;
+    std::optional<uint32_t> captureId(const QString &name) const;
+
+    // The range marks of the captures are only created when used, most scripts only need one or two of them.
+    std::shared_ptr<treesitter::Query> m_query;
+    // Capture ids, in the same order as the ranges.
+    QList<uint32_t> m_ids;
+    std::shared_ptr<LazyRangeMarks> m_ranges;
 };
 
 using QueryMatchList = QList<Core::QueryMatch>;
@@ -0,0 +1,65 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "querymatchiterator.h"
+#include "codedocument.h"
+#include "codedocument_p.h"
+#include "utils/log.h"
+
+namespace Core {
+
+QueryMatchIterator::QueryMatchIterator(CodeDocument *document, std::optional<treesitter::QueryCursor> &&cursor)
+    : m_document(document)
+    , m_cursor(std::move(cursor))
+    , m_version(document->helper()->version())
+{
+}
+
+QueryMatchIterator::~QueryMatchIterator() = default;
+
+bool QueryMatchIterator::atEnd() const
+{
+    return !m_cursor.has_value();
+}
+
+bool QueryMatchIterator::isTruncated() const
+{
+    return m_truncated;
+}
+
+Core::QueryMatch QueryMatchIterator::next()
+{
+    if (!m_cursor.has_value()) {
+        return {};
+    }
+
+    // The cursor points into the syntax tree, which can't be used anymore once the document is changed.
+    if (!m_document || m_document->helper()->version() != m_version) {
+        spdlog::warn("{}: The document changed, stopping the query", FUNCTION_NAME);
+        close();
+        return {};
+    }
+
+    auto match = m_cursor->nextMatch();
+    if (!match.has_value()) {
+        m_truncated = m_cursor->truncation() != treesitter::QueryCursor::Truncation::None;
+        close();
+        return {};
+    }
+
+    return QueryMatch(*m_document, match.value());
+}
+
+void QueryMatchIterator::close()
+{
+    m_cursor.reset();
+}
+
+} // namespace Core
@@ -0,0 +1,53 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "querymatch.h"
+#include "treesitter/query.h"
+
+#include <QObject>
+#include <QPointer>
+
+namespace Core {
+
+class CodeDocument;
+
+// Lazily returns the matches of a query, see CodeDocument::queryIter.
+class QueryMatchIterator : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(bool atEnd READ atEnd FINAL)
+    Q_PROPERTY(bool truncated READ isTruncated FINAL)
+
+public:
+    ~QueryMatchIterator() override;
+
+    bool atEnd() const;
+    // True if the iteration stopped early, because of one of the query limits.
+    bool isTruncated() const;
+
+    // Returns an empty match, and sets atEnd, once there are no more matches.
+    Q_INVOKABLE Core::QueryMatch next();
+    // Stops the iteration, no more matches will be returned.
+    Q_INVOKABLE void close();
+
+private:
+    friend class CodeDocument;
+    QueryMatchIterator(CodeDocument *document, std::optional<treesitter::QueryCursor> &&cursor);
+
+    QPointer<CodeDocument> m_document;
+    std::optional<treesitter::QueryCursor> m_cursor;
+    int m_version;
+    bool m_truncated = false;
+};
+
+} // namespace Core
@@ -10,7 +10,6 @@
 
 #include "rangemark.h"
 #include "mark.h"
-#include "rangemark_p.h"
 #include "textdocument.h"
 #include "utils/log.h"
 
@@ -49,67 +48,39 @@ namespace Core {
  * This read-only property returns the text covered by the range.
  */
 
-RangeMarkPrivate::RangeMarkPrivate(TextDocument *editor, int start, int end)
-    : m_editor(editor)
-    , m_start(start)
-    , m_end(end)
+RangeMark::RangeMark(TextDocument *editor, int start, int end)
 {
-    ensureInvariant();
-
     Q_ASSERT(editor);
-    Q_ASSERT(isValid());
+    if (start > end) {
+        spdlog::warn("{}: invariant violated: start > end ({} > {})", FUNCTION_NAME, start, end);
+        std::swap(start, end);
+    }
+    // Edits can't move the start after the end, the invariant holds from now on.
+    m_start = MarkHandle(editor->markTable(), start);
+    m_end = MarkHandle(editor->markTable(), end);
 
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &RangeMarkPrivate::update);
+    Q_ASSERT(isValid());
 }
 
-bool RangeMarkPrivate::checkEditor() const
+bool RangeMark::isValid() const
 {
-    if (!m_editor) {
+    if (m_start.isNull())
+        return false;
+    if (!document()) {
         spdlog::error("{}: document does not exist anymore", FUNCTION_NAME);
         return false;
     }
-    return true;
-}
-
-void RangeMarkPrivate::ensureInvariant()
-{
-    if (m_start > m_end) {
-        spdlog::warn("{}: invariant violated: m_start > m_end ({} > {})", FUNCTION_NAME, m_start, m_end);
-        std::swap(m_start, m_end);
-    }
-}
-
-void RangeMarkPrivate::update(int from, int charsRemoved, int charsAdded)
-{
-    Mark::updateMark(m_start, from, charsRemoved, charsAdded);
-    Mark::updateMark(m_end, from, charsRemoved, charsAdded);
-    ensureInvariant();
-}
-
-bool RangeMarkPrivate::isValid() const
-{
-    return checkEditor() && m_start >= 0 && m_end >= 0;
-}
-
-RangeMark::RangeMark(TextDocument *editor, int start, int end)
-    : d(new RangeMarkPrivate(editor, start, end))
-{
-}
-
-bool RangeMark::isValid() const
-{
-    return d && d->isValid();
+    return start() >= 0 && end() >= 0;
 }
 
 int RangeMark::start() const
 {
-    return d ? d->m_start : -1;
+    return m_start.position();
 }
 
 int RangeMark::end() const
 {
-    return d ? d->m_end : -1;
+    return m_end.position();
 }
 
 int RangeMark::length() const
@@ -129,7 +100,7 @@ bool RangeMark::contains(const RangeMark &other) const
 
 TextDocument *RangeMark::document() const
 {
-    return d ? d->m_editor : nullptr;
+    return m_start.document();
 }
 
 QString RangeMark::text() const
@@ -222,7 +193,8 @@ QString RangeMark::textExcept(const RangeMark &other) const
 
 bool RangeMark::operator==(const RangeMark &other) const
 {
-    return d == other.d || (document() == other.document() && start() == other.start() && end() == other.end());
+    return (m_start == other.m_start && m_end == other.m_end)
+        || (document() == other.document() && start() == other.start() && end() == other.end());
 }
 
 }
@@ -10,17 +10,16 @@
 
 #pragma once
 
+#include "mark.h"
+
 #include <QObject>
-#include <memory>
 
 namespace Core {
 
 class TextDocument;
 
-// RangeMark is shared_ptr to a RangeMarkPrivate.
-// This way we can ensure that a RangeMark is easy to copy and move
-// around, whilst still ensuring the QObject that listens to the
-// changes of the TextDocument is correctly deleted both from QML and C++.
+// RangeMark is a pair of handles on positions in the mark table of the TextDocument, see Mark.
+// Note: end is exclusive, and edits never move start after end.
 class RangeMark
 {
     Q_GADGET
@@ -63,7 +62,8 @@ public:
     bool operator==(const RangeMark &other) const;
 
 private:
-    std::shared_ptr<class RangeMarkPrivate> d = nullptr;
+    MarkHandle m_start;
+    MarkHandle m_end;
 
     friend TextDocument;
 };
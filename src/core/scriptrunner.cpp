@@ -171,6 +171,16 @@ ScriptRunner::ScriptRunner(QObject *parent)
 
 ScriptRunner::~ScriptRunner() = default;
 
+static void endBatches()
+{
+    if (auto project = Project::instance()) {
+        for (auto document : project->documents()) {
+            if (auto textDocument = qobject_cast<TextDocument *>(document))
+                textDocument->endBatches();
+        }
+    }
+}
+
 QVariant ScriptRunner::runScript(const QString &fileName, nlohmann::json &&data,
                                  const std::function<void()> &endCallback)
 {
@@ -186,6 +196,9 @@ QVariant ScriptRunner::runScript(const QString &fileName, nlohmann::json &&data,
 
         // Run the script
         auto engine = getEngine(fullName);
+        // A script stopped by an exception may leave batches of edits running, which would defer the notifications
+        // of the documents forever.
+        connect(engine, &QObject::destroyed, this, &endBatches);
         if (endCallback)
             connect(engine, &QObject::destroyed, this, endCallback);
 
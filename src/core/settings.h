@@ -50,6 +50,11 @@ public:
     static inline constexpr char RcAssetColors[] = "/rc/asset_transparent_colors";
     static inline constexpr char RcLanguageMap[] = "/rc/language_map";
     static inline constexpr char CppExcludedMacros[] = "/cpp/excluded_macros";
+    static inline constexpr char TreeSitterQueryMatchLimit[] = "/treesitter/query/match_limit";
+    static inline constexpr char TreeSitterQueryTimeout[] = "/treesitter/query/timeout";
+    static inline constexpr char TreeSitterQueryMaxMatches[] = "/treesitter/query/max_matches";
+    static inline constexpr char TreeSitterMaxSyntaxTrees[] = "/treesitter/max_syntax_trees";
+    static inline constexpr char ProjectIgnore[] = "/project/ignore";
     static inline constexpr char SaveLogsToFile[] = "/logs/saveToFile";
     static inline constexpr char ScriptPaths[] = "/script_paths";
     static inline constexpr char Tab[] = "/text_editor/tab";
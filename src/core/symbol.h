@@ -14,6 +14,7 @@
 #include "rangemark.h"
 
 #include <QList>
+#include <QPointer>
 
 namespace Core {
 
@@ -70,6 +71,8 @@ protected:
     RangeMark m_range;
     RangeMark m_selectionRange;
     QueryMatch m_queryMatch;
+    // Not the parent: the symbols of an outdated symbol table are given to the JavaScript engine.
+    QPointer<CodeDocument> m_document;
 
     CodeDocument *document() const;
 
@@ -98,8 +101,6 @@ public:
     bool operator==(const Symbol &) const;
 
 private:
-    void assignContext(const QList<Symbol *> &contexts);
-
     friend class CodeDocument;
     friend class TreeSitterHelper;
 };
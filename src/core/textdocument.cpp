@@ -11,6 +11,7 @@
 #include "textdocument.h"
 #include "logger.h"
 #include "mark.h"
+#include "mark_p.h"
 #include "rangemark.h"
 #include "settings.h"
 #include "textdocument_p.h"
@@ -18,14 +19,19 @@
 #include "utils/log.h"
 #include "utils/string_helper.h"
 
+#include <QClipboard>
 #include <QFile>
+#include <QGuiApplication>
+#include <QJSEngine>
 #include <QKeyEvent>
 #include <QPlainTextEdit>
 #include <QRegularExpression>
 #include <QSignalBlocker>
 #include <QTextBlock>
+#include <QTextDocumentFragment>
 #include <QTextStream>
 #include <private/qwidgettextcontrol_p.h>
+#include <utility>
 
 namespace Core {
 
@@ -129,26 +135,41 @@ TextDocument::TextDocument(QObject *parent)
 
 TextDocument::~TextDocument()
 {
-    delete m_document;
+    delete m_textEdit;
 }
 
 TextDocument::TextDocument(Type type, QObject *parent)
     : Document(type, parent)
-    , m_document(new TextEditor)
-{
-    m_document->hide();
-    connect(m_document, &QPlainTextEdit::textChanged, this, &TextDocument::textChanged);
-    connect(m_document, &QPlainTextEdit::selectionChanged, this, &TextDocument::selectionChanged);
-    connect(m_document, &QPlainTextEdit::cursorPositionChanged, this, &TextDocument::positionChanged);
-    connect(m_document->document(), &QTextDocument::contentsChange, this, [this]() {
+    , m_textDocument(new QTextDocument(this))
+    , m_cursor(m_textDocument)
+{
+    // Needed by QPlainTextEdit, once the document is shown. Until then, lines are not wrapped: moving up or down
+    // goes to the previous or next line of text.
+    m_textDocument->setDocumentLayout(new QPlainTextDocumentLayout(m_textDocument));
+    QTextOption option = m_textDocument->defaultTextOption();
+    option.setWrapMode(QTextOption::NoWrap);
+    m_textDocument->setDefaultTextOption(option);
+
+    connect(m_textDocument, &QTextDocument::contentsChanged, this, [this]() {
+        // Only emitted once for a batch of edits, see endBatch.
+        if (m_batchDepth > 0)
+            m_textChangedInBatch = true;
+        else
+            emit textChanged();
+    });
+    connect(m_textDocument, &QTextDocument::contentsChange, this, [this]() {
         setHasChanged(true);
     });
-    m_document->installEventFilter(this);
+    // Moves of the cursor caused by an edit, the view takes care of it once created.
+    connect(m_textDocument, &QTextDocument::cursorPositionChanged, this, [this](const QTextCursor &cursor) {
+        if (cursor.isCopyOf(m_cursor))
+            emit positionChanged();
+    });
 }
 
 bool TextDocument::eventFilter(QObject *watched, QEvent *event)
 {
-    Q_ASSERT(watched == m_document);
+    Q_ASSERT(watched == m_textEdit);
 
     if (event->type() == QEvent::KeyPress) {
         auto keyEvent = static_cast<QKeyEvent *>(event);
@@ -208,11 +229,11 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::Paste)
             paste();
         else if (keyEvent == QKeySequence::Delete)
-            m_document->textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
+            textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
         else if (keyEvent == QKeySequence::Backspace
                  || (keyEvent->key() == Qt::Key_Backspace
                      && !(keyEvent->modifiers() & ~Qt::ShiftModifier))) // test is coming from QTextWidgetControl
-            m_document->textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
+            textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
         else if (keyEvent == QKeySequence::InsertParagraphSeparator)
             insert("\n");
         else if (keyEvent == QKeySequence::InsertLineSeparator)
@@ -226,7 +247,7 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::SelectAll)
             selectAll();
         else if (!keyEvent->text().isEmpty()) {
-            auto control = m_document->findChild<QWidgetTextControl *>();
+            auto control = m_textEdit->findChild<QWidgetTextControl *>();
             if (control->isAcceptableInput(keyEvent))
                 insert(keyEvent->text());
         }
@@ -250,7 +271,7 @@ bool TextDocument::doSave(const QString &fileName)
     if (m_utf8Bom)
         file.write("\xef\xbb\xbf", 3);
 
-    QString plainText = m_document->toPlainText();
+    QString plainText = m_textDocument->toPlainText();
     if (m_lineEnding == CRLFLineEnding)
         plainText.replace('\n', "\r\n");
 
@@ -277,10 +298,11 @@ bool TextDocument::doLoad(const QString &fileName)
     stream.setEncoding(static_cast<QStringConverter::Encoding>(DEFAULT_VALUE(TextDocument::Encoding, Encoding)));
     const QString text = stream.readAll();
 
-    QSignalBlocker sb(m_document->document());
+    QSignalBlocker sb(m_textDocument);
     // This will replace '\r\n' with '\n'
-    m_document->setPlainText(text);
+    setPlainText(text);
     setHasChanged(false);
+    emit textChanged();
 
     return true;
 }
@@ -309,39 +331,39 @@ void TextDocument::detectFormat(const QByteArray &data)
 int TextDocument::column() const
 {
     LOG();
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("column", cursor.positionInBlock() + 1);
 }
 
 int TextDocument::line() const
 {
     LOG();
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("line", cursor.blockNumber() + 1);
 }
 
 int TextDocument::lineCount() const
 {
     LOG();
-    return m_document->document()->lineCount();
+    return m_textDocument->lineCount();
 }
 
 int TextDocument::position() const
 {
     LOG();
-    LOG_RETURN("pos", m_document->textCursor().position());
+    LOG_RETURN("pos", textCursor().position());
 }
 
 int TextDocument::selectionStart() const
 {
     LOG();
-    LOG_RETURN("pos", m_document->textCursor().selectionStart());
+    LOG_RETURN("pos", textCursor().selectionStart());
 }
 
 int TextDocument::selectionEnd() const
 {
     LOG();
-    LOG_RETURN("pos", m_document->textCursor().selectionEnd());
+    LOG_RETURN("pos", textCursor().selectionEnd());
 }
 
 void TextDocument::setPosition(int newPosition)
@@ -350,16 +372,16 @@ void TextDocument::setPosition(int newPosition)
 
     if (position() == newPosition)
         return;
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(newPosition);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
     emit positionChanged();
 }
 
 void TextDocument::convertPosition(int pos, int *line, int *column) const
 {
     Q_ASSERT(line && column);
-    const QTextBlock block = m_document->document()->findBlock(pos);
+    const QTextBlock block = m_textDocument->findBlock(pos);
     if (!block.isValid()) {
         (*line) = -1;
         (*column) = -1;
@@ -372,7 +394,7 @@ void TextDocument::convertPosition(int pos, int *line, int *column) const
 
 int TextDocument::position(QTextCursor::MoveOperation operation, int pos) const
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
 
     if (pos != -1)
         cursor.setPosition(pos);
@@ -417,7 +439,7 @@ int TextDocument::columnAtPosition(int position)
 int TextDocument::positionAt(int line, int column)
 {
     LOG(LOG_ARG("line", line), LOG_ARG("column", column));
-    const QTextBlock block = m_document->document()->findBlockByLineNumber(line - 1);
+    const QTextBlock block = m_textDocument->findBlockByLineNumber(line - 1);
     if (!block.isValid()) {
         return -1;
     } else {
@@ -428,20 +450,20 @@ int TextDocument::positionAt(int line, int column)
 QString TextDocument::text() const
 {
     LOG();
-    LOG_RETURN("text", m_document->toPlainText());
+    LOG_RETURN("text", m_textDocument->toPlainText());
 }
 
 void TextDocument::setText(const QString &newText)
 {
     LOG(LOG_ARG("text", newText));
 
-    m_document->setPlainText(newText);
+    setPlainText(newText);
 }
 
 QString TextDocument::currentLine() const
 {
     LOG();
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine);
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -450,7 +472,7 @@ QString TextDocument::currentLine() const
 QString TextDocument::currentWord() const
 {
     LOG();
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfWord);
     cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -460,7 +482,7 @@ QString TextDocument::selectedText() const
 {
     LOG();
     // Replace \u2029 with \n
-    const QString text = m_document->textCursor().selectedText().replace(QChar(8233), "\n");
+    const QString text = textCursor().selectedText().replace(QChar(8233), "\n");
     LOG_RETURN("text", text);
 }
 
@@ -474,9 +496,53 @@ bool TextDocument::hasUtf8Bom() const
     return m_utf8Bom;
 }
 
+QTextDocument *TextDocument::qTextDocument() const
+{
+    return m_textDocument;
+}
+
 QPlainTextEdit *TextDocument::textEdit() const
 {
-    return m_document;
+    if (!m_textEdit) {
+        auto self = const_cast<TextDocument *>(this);
+        auto textEdit = new TextEditor(m_textDocument);
+        textEdit->hide();
+        // From now on, the cursor of the view is the one of the document.
+        textEdit->setTextCursor(std::exchange(self->m_cursor, {}));
+        connect(textEdit, &QPlainTextEdit::selectionChanged, self, &TextDocument::selectionChanged);
+        connect(textEdit, &QPlainTextEdit::cursorPositionChanged, self, &TextDocument::positionChanged);
+        textEdit->installEventFilter(self);
+        m_textEdit = textEdit;
+    }
+    return m_textEdit;
+}
+
+QTextCursor TextDocument::textCursor() const
+{
+    return m_textEdit ? m_textEdit->textCursor() : m_cursor;
+}
+
+void TextDocument::setTextCursor(const QTextCursor &cursor)
+{
+    if (m_textEdit) {
+        m_textEdit->setTextCursor(cursor);
+        return;
+    }
+
+    // Same signals as the ones emitted by the view
+    const auto oldCursor = std::exchange(m_cursor, cursor);
+    if (m_cursor.position() != oldCursor.position())
+        emit positionChanged();
+    if ((m_cursor.hasSelection() || oldCursor.hasSelection())
+        && (m_cursor.position() != oldCursor.position() || m_cursor.anchor() != oldCursor.anchor()))
+        emit selectionChanged();
+}
+
+void TextDocument::setPlainText(const QString &text)
+{
+    // Same as QPlainTextEdit::setPlainText, the undo stack is cleared and the cursor goes back to the start.
+    m_textDocument->setPlainText(text);
+    setTextCursor(QTextCursor(m_textDocument));
 }
 
 /**
@@ -497,10 +563,12 @@ QString TextDocument::tab() const
 void TextDocument::undo(int count)
 {
     LOG_AND_MERGE(count);
+    auto cursor = textCursor();
     while (count != 0) {
-        m_document->undo();
+        m_textDocument->undo(&cursor);
         --count;
     }
+    setTextCursor(cursor);
 }
 
 /*!
@@ -510,17 +578,112 @@ void TextDocument::undo(int count)
 void TextDocument::redo(int count)
 {
     LOG_AND_MERGE(count);
+    auto cursor = textCursor();
     while (count != 0) {
-        m_document->redo();
+        m_textDocument->redo(&cursor);
         --count;
     }
+    setTextCursor(cursor);
+}
+
+/*!
+ * \qmlmethod TextDocument::beginBatch()
+ * Starts a batch of edits, ended by calling `endBatch`. Batches can be nested, only the outermost one counts.
+ *
+ * During a batch, the `textChanged` signal and the synchronization of the document with the language server are
+ * deferred, and done once when the batch ends. Use it when a script makes many edits in a row:
+ *
+ * ```js
+ * document.beginBatch()
+ * for (let line = 1; line <= document.lineCount; ++line)
+ *     document.insertAtLine("// ", line)
+ * document.endBatch()
+ * ```
+ *
+ * Marks, range marks and queries stay up to date during the batch.
+ *
+ * Prefer `applyEdits`, which ends the batch even if an exception is thrown. Batches still running when a script ends
+ * are ended anyway.
+ */
+void TextDocument::beginBatch()
+{
+    LOG();
+    ++m_batchDepth;
+}
+
+/*!
+ * \qmlmethod TextDocument::endBatch()
+ * Ends a batch of edits started with `beginBatch`.
+ */
+void TextDocument::endBatch()
+{
+    LOG();
+    if (m_batchDepth == 0) {
+        spdlog::warn("{}: No batch of edits to end.", FUNCTION_NAME);
+        return;
+    }
+    if (--m_batchDepth > 0)
+        return;
+
+    batchFinished();
+    if (std::exchange(m_textChangedInBatch, false))
+        emit textChanged();
+}
+
+/*!
+ * \qmlmethod TextDocument::applyEdits(function edits)
+ * Calls the `edits` function in a batch of edits, see `beginBatch`. The batch is ended even if `edits` throws an
+ * exception.
+ *
+ * ```js
+ * document.applyEdits(() => {
+ *     for (let line = 1; line <= document.lineCount; ++line)
+ *         document.insertAtLine("// ", line)
+ * })
+ * ```
+ */
+void TextDocument::applyEdits(const QJSValue &edits)
+{
+    LOG();
+    if (!edits.isCallable()) {
+        spdlog::error("{}: The edits are not a function.", FUNCTION_NAME);
+        return;
+    }
+
+    beginBatch();
+    // Exceptions thrown by the function are returned by call.
+    const auto result = edits.call();
+    endBatch();
+
+    if (result.isError()) {
+        if (auto engine = qjsEngine(this))
+            engine->throwError(result);
+    }
+}
+
+void TextDocument::endBatches()
+{
+    if (m_batchDepth == 0)
+        return;
+    spdlog::warn("{}: {} batch(es) of edits not ended in {}.", FUNCTION_NAME, m_batchDepth, fileName());
+    m_batchDepth = 1;
+    endBatch();
+}
+
+bool TextDocument::isInBatch() const
+{
+    return m_batchDepth > 0;
+}
+
+void TextDocument::batchFinished()
+{
 }
 
 void TextDocument::movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode, int count)
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(operation, mode, count);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -533,21 +696,16 @@ void TextDocument::gotoLine(int line, int column)
 {
     LOG(LOG_ARG("line", line), LOG_ARG("column", column));
 
-    gotoLineInTextEdit(m_document, line, column);
-}
-
-void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column)
-{
     // Internally, columns are 0-based, while 1-based on the API
     column = column - 1;
-    const int blockNumber = qMin(line, textEdit->document()->blockCount()) - 1;
-    const QTextBlock &block = textEdit->document()->findBlockByNumber(blockNumber);
+    const int blockNumber = qMin(line, m_textDocument->blockCount()) - 1;
+    const QTextBlock &block = m_textDocument->findBlockByNumber(blockNumber);
     if (block.isValid()) {
         QTextCursor cursor(block);
         if (column > 0)
             cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
 
-        textEdit->setTextCursor(cursor);
+        setTextCursor(cursor);
     }
 }
 
@@ -678,9 +836,9 @@ void TextDocument::gotoEndOfDocument()
 void TextDocument::unselect()
 {
     LOG();
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.clearSelection();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -690,7 +848,7 @@ void TextDocument::unselect()
 bool TextDocument::hasSelection()
 {
     LOG();
-    return m_document->textCursor().hasSelection();
+    return textCursor().hasSelection();
 }
 
 /*!
@@ -700,7 +858,9 @@ bool TextDocument::hasSelection()
 void TextDocument::selectAll()
 {
     LOG();
-    m_document->selectAll();
+    auto cursor = textCursor();
+    cursor.select(QTextCursor::Document);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -710,9 +870,9 @@ void TextDocument::selectAll()
 void TextDocument::selectTo(int pos)
 {
     LOG(LOG_ARG("pos", pos));
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -822,10 +982,10 @@ void TextDocument::selectNextWord(int count)
 void TextDocument::selectRegion(int from, int to)
 {
     LOG(from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_textDocument);
     cursor.setPosition(from, QTextCursor::MoveAnchor);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -849,7 +1009,8 @@ void TextDocument::selectRange(const RangeMark &range)
 void TextDocument::copy()
 {
     LOG();
-    m_document->copy();
+    if (const auto cursor = textCursor(); cursor.hasSelection())
+        QGuiApplication::clipboard()->setText(cursor.selection().toPlainText());
 }
 
 /*!
@@ -859,7 +1020,12 @@ void TextDocument::copy()
 void TextDocument::paste()
 {
     LOG();
-    m_document->paste();
+    const auto text = QGuiApplication::clipboard()->text();
+    if (text.isEmpty())
+        return;
+    auto cursor = textCursor();
+    cursor.insertText(text);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -869,7 +1035,12 @@ void TextDocument::paste()
 void TextDocument::cut()
 {
     LOG();
-    m_document->cut();
+    auto cursor = textCursor();
+    if (!cursor.hasSelection())
+        return;
+    QGuiApplication::clipboard()->setText(cursor.selection().toPlainText());
+    cursor.removeSelectedText();
+    setTextCursor(cursor);
 }
 
 /*!
@@ -879,10 +1050,10 @@ void TextDocument::cut()
 void TextDocument::remove(int length)
 {
     LOG(length);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -892,7 +1063,9 @@ void TextDocument::remove(int length)
 void TextDocument::insert(const QString &text)
 {
     LOG_AND_MERGE(LOG_ARG("text", text));
-    m_document->insertPlainText(text);
+    auto cursor = textCursor();
+    cursor.insertText(text);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -906,10 +1079,10 @@ void TextDocument::insertAtLine(const QString &text, int line)
     else
         LOG(LOG_ARG("text", text), LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, m_textDocument->blockCount()) - 1;
+        const QTextBlock &block = m_textDocument->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     }
@@ -923,7 +1096,7 @@ void TextDocument::insertAtLine(const QString &text, int line)
 void TextDocument::insertAtPosition(const QString &text, int pos)
 {
     LOG(text, pos);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos);
     cursor.beginEditBlock();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
@@ -938,10 +1111,10 @@ void TextDocument::insertAtPosition(const QString &text, int pos)
 void TextDocument::replace(int length, const QString &text)
 {
     LOG(length, text);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -951,11 +1124,11 @@ void TextDocument::replace(int length, const QString &text)
 void TextDocument::replace(int from, int to, const QString &text)
 {
     LOG(from, to, text);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_textDocument);
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -979,10 +1152,10 @@ void TextDocument::deleteLine(int line)
     else
         LOG(LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, m_textDocument->blockCount()) - 1;
+        const QTextBlock &block = m_textDocument->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     } else {
@@ -999,7 +1172,7 @@ void TextDocument::deleteLine(int line)
 void TextDocument::deleteSelection()
 {
     LOG();
-    m_document->textCursor().removeSelectedText();
+    textCursor().removeSelectedText();
 }
 
 /*!
@@ -1009,11 +1182,11 @@ void TextDocument::deleteSelection()
 void TextDocument::deleteRegion(int from, int to)
 {
     LOG(from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(m_textDocument);
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1037,10 +1210,10 @@ void TextDocument::deleteRange(const RangeMark &range)
 void TextDocument::deleteEndOfLine()
 {
     LOG();
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1050,10 +1223,10 @@ void TextDocument::deleteEndOfLine()
 void TextDocument::deleteStartOfLine()
 {
     LOG();
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1063,11 +1236,11 @@ void TextDocument::deleteStartOfLine()
 void TextDocument::deleteEndOfWord()
 {
     LOG();
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::NextWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1077,11 +1250,11 @@ void TextDocument::deleteEndOfWord()
 void TextDocument::deleteStartOfWord()
 {
     LOG();
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::PreviousWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1091,10 +1264,10 @@ void TextDocument::deleteStartOfWord()
 void TextDocument::deletePreviousCharacter(int count)
 {
     LOG_AND_MERGE(count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1104,10 +1277,17 @@ void TextDocument::deletePreviousCharacter(int count)
 void TextDocument::deleteNextCharacter(int count)
 {
     LOG_AND_MERGE(count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
+}
+
+MarkTable *TextDocument::markTable()
+{
+    if (!m_markTable)
+        m_markTable = new MarkTable(this);
+    return m_markTable;
 }
 
 /*!
@@ -1136,9 +1316,9 @@ void TextDocument::gotoMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position());
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1153,9 +1333,9 @@ void TextDocument::selectToMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position(), QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /**
@@ -1181,7 +1361,7 @@ Core::RangeMark TextDocument::createRangeMark(int from, int to)
 Core::RangeMark TextDocument::createRangeMark()
 {
     LOG();
-    const auto cursor = m_document->textCursor();
+    const auto cursor = textCursor();
     const int start = cursor.selectionStart();
     const int end = cursor.selectionEnd();
 
@@ -1209,8 +1389,13 @@ bool TextDocument::find(const QString &text, FindFlags options)
         return findRegexp(text, options);
     else if (options & FindWholeWords)
         return findRegexp(QRegularExpression::escape(text), options);
-    else
-        return m_document->find(text, static_cast<QTextDocument::FindFlags>(static_cast<int>(options)));
+
+    const auto cursor =
+        m_textDocument->find(text, textCursor(), static_cast<QTextDocument::FindFlags>(static_cast<int>(options)));
+    if (cursor.isNull())
+        return false;
+    setTextCursor(cursor);
+    return true;
 }
 
 /*!
@@ -1231,14 +1416,10 @@ bool TextDocument::findRegexp(const QString &regexp, FindFlags options)
     return found.has_value();
 }
 
-auto TextDocument::selectRegexpMatch(
-    QString regexp, int options,
-    const std::function<bool(const QRegularExpression &, const QRegularExpressionMatch &, const QTextCursor &)>
-        &selectionFunction) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>
+// Regular expression used to search `regexp` with the given options, see TextDocument::findRegexp.
+static QRegularExpression findExpression(QString regexp, int options)
 {
-    unselect();
-
-    if (options & FindWholeWords) {
+    if (options & TextDocument::FindWholeWords) {
         if (!regexp.startsWith("\\b"))
             regexp = "\\b" + regexp;
         if (!regexp.endsWith("\\b"))
@@ -1250,8 +1431,19 @@ auto TextDocument::selectRegexpMatch(
         expression.setPatternOptions(expression.patternOptions() & ~QRegularExpression::CaseInsensitiveOption);
     else
         expression.setPatternOptions(expression.patternOptions() | QRegularExpression::CaseInsensitiveOption);
+    return expression;
+}
 
-    const QTextCursor startCursor = m_document->textCursor();
+auto TextDocument::selectRegexpMatch(
+    QString regexp, int options,
+    const std::function<bool(const QRegularExpression &, const QRegularExpressionMatch &, const QTextCursor &)>
+        &selectionFunction) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>
+{
+    unselect();
+
+    const auto expression = findExpression(regexp, options);
+
+    const QTextCursor startCursor = textCursor();
     QTextBlock block = startCursor.block();
     int blockOffset = startCursor.positionInBlock();
 
@@ -1260,7 +1452,7 @@ auto TextDocument::selectRegexpMatch(
         if (found.has_value()) {
             const auto &[match, newCursor] = *found;
             if (selectionFunction(expression, match, newCursor)) {
-                m_document->setTextCursor(newCursor);
+                setTextCursor(newCursor);
                 return found;
             }
 
@@ -1336,9 +1528,9 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, FindF
 {
     LOG(LOG_ARG("text", before), after, options);
 
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(QTextCursor::Start);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
@@ -1346,7 +1538,7 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, FindF
     const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
     if (find(before, options)) {
         cursor.beginEditBlock();
-        const auto found = m_document->textCursor();
+        const auto found = textCursor();
         cursor.setPosition(found.selectionStart());
         cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
         QString afterText = after;
@@ -1387,7 +1579,7 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, FindF
 int TextDocument::replaceAll(const QString &before, const QString &after, FindFlags options /* = NoFindFlags */)
 {
     LOG(LOG_ARG("text", before), after, options);
-    return replaceAll(before, after, options, [](auto) {
+    return replaceAll(before, after, options, [](int, int) {
         return true;
     });
 }
@@ -1414,47 +1606,98 @@ int TextDocument::replaceAllInRange(const QString &before, const QString &after,
         return 0;
     }
 
-    return replaceAll(before, after, options, [&range](auto cursor) {
-        return range.start() <= cursor.selectionStart()
-            && cursor.selectionEnd()
-            <= range.end(); // Use <= here, as the selection may be equal to the range, both values are exclusive.
+    return replaceAll(before, after, options, [&range](int start, int end) {
+        // Use <= here, as the match may be equal to the range, both ends are exclusive.
+        return range.start() <= start && end <= range.end();
     });
 }
 
 int TextDocument::replaceAll(const QString &before, const QString &after, FindFlags options,
-                             const std::function<bool(QTextCursor)> &filterAcceptsCursor)
+                             const std::function<bool(int, int)> &filterAcceptsRange)
 {
-    const bool backwards = options & FindBackward;
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
 
-    int count = 0;
-    auto cursor = m_document->textCursor();
-    cursor.movePosition(backwards ? QTextCursor::End : QTextCursor::Start);
-    m_document->setTextCursor(cursor);
-    cursor.beginEditBlock();
+    // Same matches as find: the text is searched line by line, and the lines are not modified while searching.
+    QRegularExpression expression;
+    if (usesRegExp || (options & FindWholeWords)) {
+        expression = findExpression(usesRegExp ? before : QRegularExpression::escape(before), options);
+    } else if (!before.isEmpty()) {
+        expression = QRegularExpression(QRegularExpression::escape(before),
+                                        (options & FindCaseSensitively) ? QRegularExpression::NoPatternOption
+                                                                        : QRegularExpression::CaseInsensitiveOption);
+    } else {
+        return 0;
+    }
+    if (!expression.isValid()) {
+        spdlog::warn("{}: Invalid regexp '{}': {}", FUNCTION_NAME, before, expression.errorString());
+        return 0;
+    }
+    expression.optimize();
+
+    // All matches are found in a snapshot of the text first, then replaced in a single edit. Replacing them one by one
+    // would update the marks, the syntax tree... for each of them.
+    // The raw text has the same positions as the document, with QChar::ParagraphSeparator between the lines.
+    const auto rawText = m_textDocument->toRawText();
+    auto text = rawText;
+    // Same as QTextDocument::find
+    text.replace(QChar::Nbsp, u' ');
 
-    const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
-    while (find(before, options)) {
-        const auto found = m_document->textCursor();
-        cursor.setPosition(found.selectionStart());
-        cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
-        if (!filterAcceptsCursor(cursor)) {
-            // Result filtered, so do not replace.
-            continue;
-        }
-        QString afterText = after;
-        if (usesRegExp) {
-            QRegularExpressionMatch match = regexp.match(selectedText());
-            afterText = Utils::expandRegExpReplacement(after, match.capturedTexts());
-        } else if (preserveCase) {
-            afterText = Utils::matchCaseReplacement(cursor.selectedText(), after);
+    std::vector<MarkTable::Replacement> replacements;
+    QStringList afterTexts;
+    for (qsizetype lineStart = 0; lineStart <= text.size();) {
+        auto lineEnd = text.indexOf(QChar::ParagraphSeparator, lineStart);
+        if (lineEnd == -1)
+            lineEnd = text.size();
+
+        auto matches = expression.globalMatchView(QStringView(text).sliced(lineStart, lineEnd - lineStart));
+        while (matches.hasNext()) {
+            const auto match = matches.next();
+            const auto start = static_cast<int>(lineStart + match.capturedStart());
+            const auto end = static_cast<int>(lineStart + match.capturedEnd());
+            if (!filterAcceptsRange(start, end)) {
+                // Result filtered, so do not replace.
+                continue;
+            }
+
+            QString afterText = after;
+            if (usesRegExp) {
+                afterText = Utils::expandRegExpReplacement(after, match.capturedTexts());
+            } else if (preserveCase) {
+                afterText = Utils::matchCaseReplacement(rawText.sliced(start, end - start), after);
+            }
+            replacements.push_back({.start = start, .end = end, .length = static_cast<int>(afterText.size())});
+            afterTexts.push_back(std::move(afterText));
         }
-        cursor.insertText(afterText);
-        ++count;
+        lineStart = lineEnd + 1;
     }
 
-    cursor.endEditBlock();
+    if (replacements.empty())
+        return 0;
+
+    // Only the text between the first and the last match is changed.
+    const int changeStart = replacements.front().start;
+    const int changeEnd = replacements.back().end;
+    QString newText;
+    int position = changeStart;
+    for (size_t i = 0; i < replacements.size(); ++i) {
+        newText += QStringView(rawText).sliced(position, replacements[i].start - position);
+        newText += afterTexts.at(i);
+        position = replacements[i].end;
+    }
+
+    const auto count = static_cast<int>(replacements.size());
+    if (m_markTable)
+        m_markTable->setReplacements(std::move(replacements));
+
+    auto cursor = textCursor();
+    cursor.setPosition(changeStart);
+    cursor.setPosition(changeEnd, QTextCursor::KeepAnchor);
+    cursor.insertText(newText);
+    setTextCursor(cursor);
+
+    if (m_markTable)
+        m_markTable->setReplacements({});
     return count;
 }
 
@@ -1472,7 +1715,7 @@ int TextDocument::replaceAll(const QString &before, const QString &after, FindFl
 int TextDocument::replaceAllRegexp(const QString &regexp, const QString &after, FindFlags options /* = NoFindFlags */)
 {
     LOG(LOG_ARG("text", regexp), after, options);
-    return replaceAllRegexp(regexp, after, options, [](auto) {
+    return replaceAllRegexp(regexp, after, options, [](int, int) {
         return true;
     });
 }
@@ -1500,17 +1743,16 @@ int TextDocument::replaceAllRegexpInRange(const QString &regexp, const QString &
         return 0;
     }
 
-    return replaceAllRegexp(regexp, after, options, [&range](auto cursor) {
-        return range.start() <= cursor.selectionStart()
-            && cursor.selectionEnd()
-            <= range.end(); // Use <= here, as the selection may be equal to the range, both values are exclusive.
+    return replaceAllRegexp(regexp, after, options, [&range](int start, int end) {
+        // Use <= here, as the match may be equal to the range, both ends are exclusive.
+        return range.start() <= start && end <= range.end();
     });
 }
 
 int TextDocument::replaceAllRegexp(const QString &regexp, const QString &after, FindFlags options,
-                                   const std::function<bool(QTextCursor)> &filterAcceptsCursor)
+                                   const std::function<bool(int, int)> &filterAcceptsRange)
 {
-    return replaceAll(regexp, after, options | FindRegexp, filterAcceptsCursor);
+    return replaceAll(regexp, after, options | FindRegexp, filterAcceptsRange);
 }
 
 static int columnAt(const QString &text, int position, int tabSize)
@@ -1559,18 +1801,19 @@ static int indentOneLine(QTextCursor &cursor, int tabCount, const TabSettings &s
     return text.size() - oldSize;
 }
 
-static void indentBlocksInTextEdit(QPlainTextEdit *textEdit, int blockStart, int blockEnd, int tabCount, bool relative)
+// Returns the cursor to use once the lines are indented.
+static QTextCursor indentBlocks(QTextCursor cursor, int blockStart, int blockEnd, int tabCount, bool relative)
 {
     const auto settings = DEFAULT_VALUE(Core::TabSettings, Tab);
-    QTextCursor cursor = textEdit->textCursor();
+    const auto document = cursor.document();
 
     // Make sure we don't move the cursor outside the first line it started on.
-    const int minStart = textEdit->document()->findBlock(cursor.selectionStart()).position();
+    const int minStart = document->findBlock(cursor.selectionStart()).position();
     int newStart = cursor.selectionStart();
     int newEnd = cursor.selectionEnd();
 
     // Move the position to the beginning of the first line
-    cursor.setPosition(textEdit->document()->findBlockByNumber(blockStart).position());
+    cursor.setPosition(document->findBlockByNumber(blockStart).position());
 
     cursor.beginEditBlock();
     // Iterate through all line, and change the indentation
@@ -1597,16 +1840,20 @@ static void indentBlocksInTextEdit(QPlainTextEdit *textEdit, int blockStart, int
     cursor.setPosition(qMax(minStart, newStart));
     cursor.setPosition(qMax(minStart, newEnd), QTextCursor::KeepAnchor);
 
-    textEdit->setTextCursor(cursor);
+    return cursor;
 }
 
-void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount, bool relative)
+static QTextCursor indentText(const QTextCursor &cursor, int tabCount, bool relative)
 {
-    QTextCursor cursor = textEdit->textCursor();
-    const int blockStart = textEdit->document()->findBlock(cursor.selectionStart()).blockNumber();
-    const int blockEnd = textEdit->document()->findBlock(cursor.selectionEnd()).blockNumber();
+    const int blockStart = cursor.document()->findBlock(cursor.selectionStart()).blockNumber();
+    const int blockEnd = cursor.document()->findBlock(cursor.selectionEnd()).blockNumber();
 
-    indentBlocksInTextEdit(textEdit, blockStart, blockEnd, tabCount, relative);
+    return indentBlocks(cursor, blockStart, blockEnd, tabCount, relative);
+}
+
+void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount, bool relative)
+{
+    textEdit->setTextCursor(indentText(textEdit->textCursor(), tabCount, relative));
 }
 
 /*!
@@ -1620,7 +1867,7 @@ void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount, bool relative)
 void TextDocument::indent(int count)
 {
     LOG_AND_MERGE(count);
-    indentTextInTextEdit(m_document, count);
+    setTextCursor(indentText(textCursor(), count, true));
 }
 
 /*!
@@ -1633,7 +1880,7 @@ void TextDocument::indentLine(int count, int line)
 {
     LOG(LOG_ARG("count", count), LOG_ARG("line", line));
 
-    indentBlocksInTextEdit(m_document, line - 1, line - 1, count, true);
+    setTextCursor(indentBlocks(textCursor(), line - 1, line - 1, count, true));
 }
 
 /*!
@@ -1647,7 +1894,7 @@ void TextDocument::setIndentation(int indent)
 {
     LOG(LOG_ARG("indent", indent));
 
-    indentTextInTextEdit(m_document, indent, false);
+    setTextCursor(indentText(textCursor(), indent, false));
 }
 
 /*!
@@ -1660,7 +1907,7 @@ void TextDocument::setIndentationAtLine(int indent, int line)
 {
     LOG(LOG_ARG("indent", indent), LOG_ARG("line", line));
 
-    indentBlocksInTextEdit(m_document, line - 1, line - 1, indent, false);
+    setTextCursor(indentBlocks(textCursor(), line - 1, line - 1, indent, false));
 }
 
 void TextDocument::setLineEnding(LineEnding newLineEnding)
@@ -1683,7 +1930,7 @@ QString TextDocument::indentTextAtPosition(int pos) const
 {
     LOG(LOG_ARG("position", pos));
 
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(pos);
     cursor.movePosition(QTextCursor::StartOfLine);
     const QString line = cursor.block().text();
@@ -1711,7 +1958,7 @@ QString TextDocument::indentTextAtLine(int line /* = -1 */) const
     // API-wise the line numbers are 1-based, but internally they are 0-based
     auto blockNumber = line - 1;
 
-    const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+    const QTextBlock &block = m_textDocument->findBlockByNumber(blockNumber);
     if (block.isValid()) {
         return indentTextAtPosition(block.position());
     }
@@ -15,6 +15,7 @@
 #include "rangemark.h"
 #include "utils/json.h"
 
+#include <QJSValue>
 #include <QPointer>
 #include <QRegularExpressionMatch>
 #include <QTextCursor>
@@ -24,6 +25,7 @@ class QPlainTextEdit;
 
 namespace Core {
 
+class LazyRangeMarks;
 class RangeMark;
 
 class TextDocument : public Document
@@ -101,10 +103,19 @@ public:
 
     bool hasUtf8Bom() const;
 
+    // The text, cursor and undo stack of the document. A view is only created when needed, e.g. to show the
+    // document, so scripts running without any GUI don't pay for a widget per document.
+    QTextDocument *qTextDocument() const;
     QPlainTextEdit *textEdit() const;
+    // The cursor of the view once it exists.
+    QTextCursor textCursor() const;
+    void setTextCursor(const QTextCursor &cursor);
 
     QString tab() const;
 
+    // Ends all running batches, e.g. the ones left by a script stopped by an exception.
+    void endBatches();
+
 public slots:
     void setPosition(int newPosition);
     void setText(const QString &newText);
@@ -117,6 +128,11 @@ public slots:
     void undo(int count = 1);
     void redo(int count = 1);
 
+    // Batch of edits
+    void beginBatch();
+    void endBatch();
+    void applyEdits(const QJSValue &edits);
+
     // Goto methods, to move around the document
     void gotoLine(int line, int column = 1);
     void gotoStartOfLine();
@@ -225,17 +241,29 @@ protected:
     bool doSave(const QString &fileName) override;
     bool doLoad(const QString &fileName) override;
 
-    friend MarkPrivate;
+    // True between beginBatch and the matching endBatch.
+    bool isInBatch() const;
+    // Called when the outermost batch ends, to send the notifications deferred during the batch.
+    virtual void batchFinished();
+
+    friend Mark;
+    friend RangeMark;
+    friend LazyRangeMarks;
     void convertPosition(int pos, int *line, int *column) const;
     int position(QTextCursor::MoveOperation operation, int pos) const;
 
+    // The filter gets the start and end positions of each match.
     int replaceAll(const QString &before, const QString &after, FindFlags options,
-                   const std::function<bool(QTextCursor)> &filterAcceptsCursor);
+                   const std::function<bool(int, int)> &filterAcceptsRange);
     int replaceAllRegexp(const QString &regexp, const QString &after, FindFlags options,
-                         const std::function<bool(QTextCursor)> &filterAcceptsCursor);
+                         const std::function<bool(int, int)> &filterAcceptsRange);
 
 private:
     void detectFormat(const QByteArray &data);
+    void setPlainText(const QString &text);
+
+    // Created with the first mark, so the marks are updated after the handlers connected by the document itself.
+    MarkTable *markTable();
 
     void movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode = QTextCursor::MoveAnchor,
                       int count = 1);
@@ -247,9 +275,13 @@ private:
                 return true;
             }) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>;
 
-    // TODO: use a QTextDocument maybe, to avoid creating a widget
-    // The QPlainTextEdit has a nicer API, so it's slightly easier with that now
-    QPointer<QPlainTextEdit> m_document;
+    QTextDocument *const m_textDocument;
+    // Only used until the view is created, see textEdit.
+    QTextCursor m_cursor;
+    mutable QPointer<QPlainTextEdit> m_textEdit;
+    MarkTable *m_markTable = nullptr;
+    int m_batchDepth = 0;
+    bool m_textChangedInBatch = false;
     LineEnding m_lineEnding = NativeLineEnding;
     bool m_utf8Bom = false;
 };
@@ -26,6 +26,5 @@ struct TabSettings
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TabSettings, insertSpaces, tabSize);
 
 void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount, bool relative = true);
-void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column = 1);
 
 } // namespace Core
@@ -37,10 +37,11 @@ private:
 
 // =====================================================================================================================
 
-TextEditor::TextEditor(QWidget *parent)
+TextEditor::TextEditor(QTextDocument *document, QWidget *parent)
     : QPlainTextEdit(parent)
     , m_gutter(new Gutter(this))
 {
+    setDocument(document);
     connect(this, &TextEditor::blockCountChanged, this, &TextEditor::updateGutterWidth);
     connect(this, &TextEditor::updateRequest, this, &TextEditor::updateGutter);
     connect(this, &TextEditor::cursorPositionChanged, this, &TextEditor::updateCurrentLine);
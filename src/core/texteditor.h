@@ -21,7 +21,7 @@ class TextEditor : public QPlainTextEdit
     Q_OBJECT
 
 public:
-    explicit TextEditor(QWidget *parent = nullptr);
+    explicit TextEditor(QTextDocument *document, QWidget *parent = nullptr);
 
 protected:
     void resizeEvent(QResizeEvent *) override;
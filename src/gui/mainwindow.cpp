@@ -774,6 +774,7 @@ QWidget *MainWindow::widgetForDocument(Core::Document *document)
 
         auto qmlview = new QmlView(this);
         qmlview->setDocument(qobject_cast<Core::QmlDocument *>(document));
+        qobject_cast<Core::QmlDocument *>(document)->parseInBackground();
         return qmlview;
     }
     case Core::Document::Type::QtTs: {
@@ -792,6 +793,8 @@ QWidget *MainWindow::widgetForDocument(Core::Document *document)
     case Core::Document::Type::Cpp: {
         auto codeView = new CodeView(this);
         codeView->setDocument(qobject_cast<Core::CodeDocument *>(document));
+        // Don't block the GUI while a large document is parsed
+        qobject_cast<Core::CodeDocument *>(document)->parseInBackground();
         connect(codeView, &CodeView::treeSitterExplorerRequested, this, &MainWindow::inspectTreeSitter);
         return codeView;
     }
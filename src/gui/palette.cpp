@@ -22,7 +22,7 @@
 
 #include <QAbstractTableModel>
 #include <QAction>
-#include <QDirIterator>
+#include <QDir>
 #include <QFileInfo>
 #include <QHeaderView>
 #include <QKeyEvent>
@@ -85,7 +85,12 @@ public:
 
         beginResetModel();
 
-        m_files = allFilesInDirectory(Core::Project::instance()->root());
+        Core::LoggerDisabler ld;
+        const auto files = Core::Project::instance()->allFiles(Core::Project::FullPath);
+        m_files.clear();
+        m_files.reserve(files.size());
+        for (const auto &path : files)
+            m_files.push_back({path.mid(path.lastIndexOf('/') + 1), path});
 
         auto byFileName = [](const auto &fi1, const auto &fi2) {
             return fi1.fileName < fi2.fileName;
@@ -102,22 +107,6 @@ private:
         QString path;
     };
 
-    // Returns the list of all files recursively, without the hidden files or directories (starting with '.')
-    QList<FileInfo> allFilesInDirectory(const QString &path)
-    {
-        QList<FileInfo> result;
-        QDir dir(path);
-        const auto fiList = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-        for (const auto &fi : fiList) {
-            if (fi.fileName().startsWith('.'))
-                continue;
-            if (fi.isFile())
-                result.push_back({fi.fileName(), fi.absoluteFilePath()});
-            else if (fi.isDir())
-                result.append(allFilesInDirectory(fi.absoluteFilePath()));
-        }
-        return result;
-    }
     QList<FileInfo> m_files;
 };
 
@@ -211,13 +200,22 @@ public:
         Core::LoggerDisabler ld;
         beginResetModel();
         m_symbols.clear();
-        if (auto codeDocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->currentDocument()))
-            m_symbols = codeDocument->symbols();
+        // Only wait for the current document, and only once
+        disconnect(m_syntaxTreeReadyConnection);
+        if (auto codeDocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->currentDocument())) {
+            // Don't wait for the document to be parsed, fill the list once it's done
+            if (codeDocument->isParsingInBackground())
+                m_syntaxTreeReadyConnection = connect(codeDocument, &Core::CodeDocument::syntaxTreeReady, this,
+                                                      &SymbolModel::resetSymbols, Qt::SingleShotConnection);
+            else
+                m_symbols = codeDocument->symbols();
+        }
         endResetModel();
     }
 
 private:
     QList<Core::Symbol *> m_symbols;
+    QMetaObject::Connection m_syntaxTreeReadyConnection;
 };
 
 //=============================================================================
@@ -145,7 +145,7 @@ bool TextView::eventFilter(QObject *obj, QEvent *event)
         updateMarkRect();
     if (event->type() == QEvent::ToolTip) {
         if (Core::Settings::instance()->hasLsp()) {
-            if (const auto *codedocument = qobject_cast<Core::CodeDocument *>(m_document)) {
+            if (auto *codedocument = qobject_cast<Core::CodeDocument *>(m_document)) {
                 if (const auto *helpEvent = dynamic_cast<QHelpEvent *>(event)) {
                     auto cursor = codedocument->textEdit()->cursorForPosition(helpEvent->pos());
 
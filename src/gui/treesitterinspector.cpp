@@ -27,6 +27,9 @@
 
 namespace Gui {
 
+// Delay after the last change of the document before the tree is updated, in milliseconds.
+static constexpr int UpdateDelay = 300;
+
 QueryErrorHighlighter::QueryErrorHighlighter(QTextDocument *parent)
     : KSyntaxHighlighting::SyntaxHighlighter(parent)
 {
@@ -87,7 +90,6 @@ void QueryErrorHighlighter::setUtf8Position(int position)
 TreeSitterInspector::TreeSitterInspector(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::TreeSitterInspector)
-    , m_parser(nullptr)
     , m_errorHighlighter(nullptr)
     , m_document(nullptr)
 {
@@ -128,6 +130,18 @@ TreeSitterInspector::TreeSitterInspector(QWidget *parent)
 
     connect(ui->enableUnnamed, &QCheckBox::toggled, this, &TreeSitterInspector::showUnnamedChanged);
 
+    m_updateTimer.setSingleShot(true);
+    m_updateTimer.setInterval(UpdateDelay);
+    connect(&m_updateTimer, &QTimer::timeout, this, &TreeSitterInspector::changeText);
+
+    // Only the rows of the changed nodes are updated, expand the new ones like the rest of the tree.
+    connect(&m_treemodel, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex &parent, int first, int last) {
+                for (int row = first; row <= last; ++row) {
+                    ui->treeInspector->expandRecursively(m_treemodel.index(row, 0, parent));
+                }
+            });
+
     // Set a 2/3 - 1/3 repartition for the views
     ui->splitter->setStretchFactor(0, 2);
     ui->splitter->setStretchFactor(1, 1);
@@ -246,20 +260,42 @@ void TreeSitterInspector::changeQuery()
 
 void TreeSitterInspector::showUnnamedChanged()
 {
-    // technically the text didn't change, but this will force
-    // a complete re-parse and re-build of the entire tree.
-    changeText();
+    // The rows are different, rebuild the entire tree.
+    resetTree();
 }
 
 void TreeSitterInspector::changeText()
 {
-    QString text;
-    {
-        Core::LoggerDisabler disableLogging;
-        text = m_document->text();
+    m_updateTimer.stop();
+    // Don't block the GUI while the document is parsed, changeText is called again once it's done.
+    if (!m_document || m_document->isParsingInBackground()) {
+        return;
     }
-    m_parser.setIncludedRanges(m_document->includedRanges());
-    auto tree = m_parser.parseString(text);
+    // Nothing to update yet (e.g. the document was still being parsed when opened).
+    if (m_treemodel.rowCount() == 0) {
+        resetTree();
+        return;
+    }
+
+    // Use the tree of the document, it's parsed incrementally.
+    auto tree = m_document->syntaxTreeCopy();
+    if (tree.has_value()) {
+        m_treemodel.updateTree(std::move(tree.value()), makePredicates(), ui->enableUnnamed->isChecked());
+        changeQueryState();
+    } else {
+        m_treemodel.clear();
+    }
+}
+
+void TreeSitterInspector::resetTree()
+{
+    m_updateTimer.stop();
+    if (!m_document || m_document->isParsingInBackground()) {
+        m_treemodel.clear();
+        return;
+    }
+
+    auto tree = m_document->syntaxTreeCopy();
     if (tree.has_value()) {
         m_treemodel.setTree(std::move(tree.value()), makePredicates(), ui->enableUnnamed->isChecked());
         ui->treeInspector->expandAll();
@@ -290,14 +326,17 @@ void TreeSitterInspector::setDocument(Core::CodeDocument *document)
 
     m_document = document;
     if (m_document) {
-        m_parser = treesitter::Parser::getLanguage(document->type());
-        connect(m_document, &Core::CodeDocument::textChanged, this, &TreeSitterInspector::changeText);
+        // Typing in a large document shouldn't query the tree on each keystroke.
+        connect(m_document, &Core::CodeDocument::textChanged, this, [this]() {
+            m_updateTimer.start();
+        });
+        connect(m_document, &Core::CodeDocument::syntaxTreeReady, this, &TreeSitterInspector::changeText);
         connect(m_document, &Core::CodeDocument::positionChanged, this, &TreeSitterInspector::changeCursor);
 
         changeCursor();
-        changeText();
+        resetTree();
     } else {
-        m_parser = {nullptr};
+        m_updateTimer.stop();
         m_treemodel.clear();
     }
 }
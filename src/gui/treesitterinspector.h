@@ -16,6 +16,7 @@
 #include <KSyntaxHighlighting/SyntaxHighlighter>
 #include <QDialog>
 #include <QSyntaxHighlighter>
+#include <QTimer>
 
 namespace treesitter {
 class Predicates;
@@ -61,6 +62,8 @@ private:
     void changeCurrentDocument(Core::Document *document);
     void setDocument(Core::CodeDocument *document);
     void changeText();
+    // Rebuilds the whole tree, instead of only updating the rows that changed.
+    void resetTree();
     void changeCursor();
     void changeQuery();
     void changeQueryState();
@@ -75,13 +78,15 @@ private:
 
     Ui::TreeSitterInspector *ui;
 
-    treesitter::Parser m_parser;
     TreeSitterTreeModel m_treemodel;
     QueryErrorHighlighter *m_errorHighlighter;
 
     Core::CodeDocument *m_document;
 
     QString m_queryText;
+
+    // The tree is only updated once the user stops typing.
+    QTimer m_updateTimer;
 };
 
 } // namespace Gui
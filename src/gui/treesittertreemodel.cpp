@@ -9,6 +9,7 @@
 */
 
 #include "treesittertreemodel.h"
+#include "treesitter/tree_cursor.h"
 #include "utils/log.h"
 
 #include <QBrush>
@@ -32,9 +33,11 @@ const std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTre
 
 std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTreeModel::TreeNode::children()
 {
-
-    if (m_children.empty() && childCount() > 0) {
-        auto children = m_enableUnnamed ? m_node.children() : m_node.namedChildren();
+    if (!m_childrenCreated) {
+        m_childrenCreated = true;
+        m_children.reserve(childCount());
+        auto children = m_enableUnnamed ? treesitter::NodeRange::children(m_node)
+                                        : treesitter::NodeRange::namedChildren(m_node);
         for (const auto &child : children) {
             m_children.emplace_back(new TreeNode(child, this, m_enableUnnamed));
         }
@@ -45,6 +48,9 @@ std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTreeModel
 
 int TreeSitterTreeModel::TreeNode::childCount() const
 {
+    if (m_childrenCreated) {
+        return static_cast<int>(m_children.size());
+    }
     return static_cast<int>(m_enableUnnamed ? m_node.childCount() : m_node.namedChildCount());
 }
 
@@ -266,6 +272,128 @@ void TreeSitterTreeModel::setTree(treesitter::Tree &&tree, std::unique_ptr<trees
     endResetModel();
 }
 
+void TreeSitterTreeModel::updateTree(treesitter::Tree &&tree, std::unique_ptr<treesitter::Predicates> &&predicates,
+                                     bool enableUnnamed)
+{
+    if (!m_rootNode || m_rootNode->m_enableUnnamed != enableUnnamed) {
+        setTree(std::move(tree), std::move(predicates), enableUnnamed);
+        return;
+    }
+
+    // The old tree is kept until all nodes are moved to the new one, the old nodes are still needed to compare them.
+    auto oldTree = std::exchange(m_tree, std::move(tree));
+    const Captures oldCaptures = m_query.has_value() ? std::move(m_query->captures) : Captures();
+
+    executeQuery(std::move(predicates));
+
+    if (updateNode(*m_rootNode, m_tree->rootNode(), oldCaptures)) {
+        emit dataChanged(indexFor(*m_rootNode, 0), indexFor(*m_rootNode, columnCount() - 1));
+    }
+}
+
+static bool isSameNode(const treesitter::Node &left, const treesitter::Node &right)
+{
+    // The type names are static strings of the language, no need to compare them.
+    return left.rawType() == right.rawType() && left.isNamed() == right.isNamed();
+}
+
+bool TreeSitterTreeModel::updateNode(TreeNode &node, const treesitter::Node &newNode, const Captures &oldCaptures)
+{
+    static const Captures noCaptures;
+    const auto &newCaptures = m_query.has_value() ? m_query->captures : noCaptures;
+
+    auto captureText = [](const Captures &captures, const treesitter::Node &node) {
+        const auto it = captures.find(node);
+        return it != captures.cend() ? it->second : QString();
+    };
+    auto samePoint = [](const treesitter::Point &left, const treesitter::Point &right) {
+        return left.row == right.row && left.column == right.column;
+    };
+    const auto &oldNode = node.m_node;
+    const bool changed = oldNode.startPosition() != newNode.startPosition()
+        || oldNode.endPosition() != newNode.endPosition() || !samePoint(oldNode.startPoint(), newNode.startPoint())
+        || !samePoint(oldNode.endPoint(), newNode.endPoint())
+        || captureText(oldCaptures, oldNode) != captureText(newCaptures, newNode);
+
+    // Rows may have been counted already, even if the children were never created, so the old children are needed
+    // to tell the view which rows changed.
+    const auto newChildCount = node.m_enableUnnamed ? newNode.childCount() : newNode.namedChildCount();
+    if (!node.m_childrenCreated && static_cast<int>(newChildCount) != node.childCount()) {
+        node.children();
+    }
+
+    node.m_node = newNode;
+    if (node.m_childrenCreated) {
+        updateChildren(node, oldCaptures);
+    }
+    return changed;
+}
+
+void TreeSitterTreeModel::updateChildren(TreeNode &node, const Captures &oldCaptures)
+{
+    QList<treesitter::Node> newChildren;
+    auto range = node.m_enableUnnamed ? treesitter::NodeRange::children(node.m_node)
+                                      : treesitter::NodeRange::namedChildren(node.m_node);
+    for (const auto &child : range) {
+        newChildren.push_back(child);
+    }
+
+    auto &children = node.m_children;
+    const auto oldCount = static_cast<int>(children.size());
+    const auto newCount = static_cast<int>(newChildren.size());
+
+    // An edit usually only changes a few children: keep the children at the start and at the end whose type didn't
+    // change, only the ones in between are replaced.
+    int prefix = 0;
+    while (prefix < oldCount && prefix < newCount && isSameNode(children[prefix]->m_node, newChildren[prefix])) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < oldCount - prefix && suffix < newCount - prefix
+           && isSameNode(children[oldCount - suffix - 1]->m_node, newChildren[newCount - suffix - 1])) {
+        ++suffix;
+    }
+
+    int firstChanged = -1;
+    int lastChanged = -1;
+    auto updateChild = [&](int row, const treesitter::Node &newChild) {
+        if (updateNode(*children[row], newChild, oldCaptures)) {
+            if (firstChanged == -1) {
+                firstChanged = row;
+            }
+            lastChanged = row;
+        }
+    };
+    for (int row = 0; row < prefix; ++row) {
+        updateChild(row, newChildren[row]);
+    }
+    for (int i = suffix; i > 0; --i) {
+        updateChild(oldCount - i, newChildren[newCount - i]);
+    }
+    if (firstChanged != -1) {
+        emit dataChanged(createIndex(firstChanged, 0, children[firstChanged].get()),
+                         createIndex(lastChanged, columnCount() - 1, children[lastChanged].get()));
+    }
+
+    const auto parentIndex = indexFor(node, 0);
+    if (prefix < oldCount - suffix) {
+        beginRemoveRows(parentIndex, prefix, oldCount - suffix - 1);
+        children.erase(children.begin() + prefix, children.begin() + (oldCount - suffix));
+        endRemoveRows();
+    }
+    if (prefix < newCount - suffix) {
+        beginInsertRows(parentIndex, prefix, newCount - suffix - 1);
+        std::vector<std::unique_ptr<TreeNode>> inserted;
+        inserted.reserve(newCount - suffix - prefix);
+        for (int i = prefix; i < newCount - suffix; ++i) {
+            inserted.emplace_back(new TreeNode(newChildren[i], &node, node.m_enableUnnamed));
+        }
+        children.insert(children.begin() + prefix, std::make_move_iterator(inserted.begin()),
+                        std::make_move_iterator(inserted.end()));
+        endInsertRows();
+    }
+}
+
 void TreeSitterTreeModel::clear()
 {
     beginResetModel();
@@ -279,12 +407,12 @@ void TreeSitterTreeModel::executeQuery(std::unique_ptr<treesitter::Predicates> &
 {
     treesitter::QueryCursor cursor;
 
-    if (m_rootNode && m_query.has_value()) {
+    if (m_tree && m_query.has_value()) {
         m_query->captures = decltype(m_query->captures)();
         m_query->numCaptures = 0;
         m_query->numMatches = 0;
 
-        cursor.execute(m_query->query, m_rootNode->tsNode(), std::move(predicates));
+        cursor.execute(m_query->query, m_tree->rootNode(), std::move(predicates));
 
         while (const auto match = cursor.nextMatch()) {
             m_query->numMatches++;
@@ -50,8 +50,12 @@ public:
             });
 
     private:
+        friend TreeSitterTreeModel;
+
         const TreeNode *m_parent;
         mutable std::vector<std::unique_ptr<TreeNode>> m_children;
+        // The children are created on first use, then they are the rows of the node (see updateTree).
+        mutable bool m_childrenCreated = false;
         treesitter::Node m_node;
         bool m_enableUnnamed;
     };
@@ -73,6 +77,10 @@ public:
                   std::unique_ptr<treesitter::Predicates> &&predicates);
     void setCursorPosition(int position);
     void setTree(treesitter::Tree &&tree, std::unique_ptr<treesitter::Predicates> &&predicates, bool enableUnnamed);
+    // Same as setTree, but only the rows whose node changed are updated, instead of resetting the model.
+    // The tree is expected to be a new version of the current one, e.g. after an edit of the document.
+    void updateTree(treesitter::Tree &&tree, std::unique_ptr<treesitter::Predicates> &&predicates,
+                    bool enableUnnamed);
     void clear();
 
     std::optional<treesitter::Node> tsNode(const QModelIndex &index) const;
@@ -87,6 +95,13 @@ private:
     void capturesChanged(const std::unordered_map<treesitter::Node, QString> &oldCaptures);
     void executeQuery(std::unique_ptr<treesitter::Predicates> &&predicates);
 
+    using Captures = std::unordered_map<treesitter::Node, QString>;
+    // Moves the node to the new version of its treesitter node, updating its children as well.
+    // Returns true if the data of the node changed.
+    bool updateNode(TreeNode &node, const treesitter::Node &newNode, const Captures &oldCaptures);
+    // Updates the rows of the children, once the node itself is moved to the new tree.
+    void updateChildren(TreeNode &node, const Captures &oldCaptures);
+
     int m_cursorPosition;
     std::optional<treesitter::Tree> m_tree;
 
@@ -9,6 +9,7 @@
 */
 
 #include "node.h"
+#include "tree_cursor.h"
 #include "utils/log.h"
 
 #include <kdalgorithms.h>
@@ -118,12 +119,12 @@ uint32_t Node::childCount() const
 
 QList<Node> Node::children() const
 {
-    const auto count = childCount();
     QList<Node> result;
-    result.reserve(count);
+    result.reserve(childCount());
 
-    for (uint32_t i = 0; i < count; i++) {
-        result.emplace_back(Node(ts_node_child(m_node, i)));
+    // ts_node_child looks for the child from the first one each time, the cursor doesn't.
+    for (const auto &child : NodeRange::children(*this)) {
+        result.emplace_back(child);
     }
 
     return result;
@@ -131,12 +132,11 @@ QList<Node> Node::children() const
 
 QList<Node> Node::namedChildren() const
 {
-    const auto count = namedChildCount();
     QList<Node> result;
-    result.reserve(count);
+    result.reserve(namedChildCount());
 
-    for (uint32_t i = 0; i < count; i++) {
-        result.emplace_back(Node(ts_node_named_child(m_node, i)));
+    for (const auto &child : NodeRange::namedChildren(*this)) {
+        result.emplace_back(child);
     }
 
     return result;
@@ -215,6 +215,14 @@ QString Node::textIn(const QString &source) const
     return source.sliced(start, end - start);
 }
 
+QStringView Node::textViewIn(const QString &source) const
+{
+    const auto start = this->startPosition();
+    const auto end = this->endPosition();
+
+    return QStringView(source).sliced(start, end - start);
+}
+
 QString Node::textExcept(const QString &source, const QList<QString> &nodeTypes) const
 {
     auto text = textIn(source);
@@ -239,14 +247,14 @@ QList<Node> Node::allChildrenOfType(const QList<QString> &nodeTypes) const
 {
     auto result = QList<Node>();
 
-    const auto allChildren = children();
-    for (const auto &child : allChildren) {
-        // break the recursion at the first node that is of the given type
+    auto descendants = NodeRange::descendants(*this);
+    for (auto it = descendants.begin(); it != descendants.end(); ++it) {
+        const auto child = *it;
+        // Don't go into the children of a node of the given type.
         // That way we don't get overlapping child nodes.
-        if (kdalgorithms::contains(nodeTypes, child.type())) {
+        if (nodeTypes.contains(QLatin1String(child.rawType()))) {
             result.push_back(child);
-        } else {
-            result.append(child.allChildrenOfType(nodeTypes));
+            descendants.skipChildren();
         }
     }
 
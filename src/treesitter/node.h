@@ -59,6 +59,8 @@ public:
     bool hasError() const;
 
     QString textIn(const QString &source) const;
+    // Same as textIn, without allocating a new string. The view is only valid as long as source is.
+    QStringView textViewIn(const QString &source) const;
     QString textExcept(const QString &source, const QVector<QString> &nodeTypes) const;
 
     Node descendantForRange(uint32_t left, uint32_t right) const;
@@ -13,10 +13,48 @@
 #include "treesitter/languages.h"
 
 #include <tree_sitter/api.h>
+#include <unordered_map>
 #include <utility>
 
 namespace treesitter {
 
+namespace {
+
+// Parsers can't be used by multiple threads at once, so each thread has its own pool.
+class ParserPool
+{
+public:
+    static ParserPool &local()
+    {
+        thread_local ParserPool pool;
+        return pool;
+    }
+
+    Parser take(Core::Document::Type type)
+    {
+        auto it = m_parsers.find(type);
+        if (it == m_parsers.end()) {
+            return Parser(Parser::getLanguage(type));
+        }
+        auto parser = std::move(it->second);
+        m_parsers.erase(it);
+        return parser;
+    }
+
+    void release(Core::Document::Type type, Parser &&parser)
+    {
+        // Don't let the included ranges of the last parse leak into the next one.
+        parser.setIncludedRanges({});
+        // Only one parser per language is kept, if several were borrowed at the same time the others are deleted.
+        m_parsers.try_emplace(type, std::move(parser));
+    }
+
+private:
+    std::unordered_map<Core::Document::Type, Parser> m_parsers;
+};
+
+}
+
 Parser::Parser(TSLanguage *language)
     : m_parser(ts_parser_new())
 {
@@ -83,4 +121,16 @@ TSLanguage *Parser::getLanguage(Core::Document::Type type)
         Q_UNREACHABLE();
     }
 }
+
+PooledParser::PooledParser(Core::Document::Type type)
+    : m_type(type)
+    , m_parser(ParserPool::local().take(type))
+{
+}
+
+PooledParser::~PooledParser()
+{
+    ParserPool::local().release(m_type, std::move(m_parser.value()));
+}
+
 }
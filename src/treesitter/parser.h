@@ -12,6 +12,7 @@
 
 #include "core/document.h"
 #include <QString>
+#include <optional>
 #include <tree_sitter/api.h>
 #include <vector>
 
@@ -63,4 +64,25 @@ private:
     TSParser *m_parser;
 };
 
+// Parser borrowed from the pool of the current thread, which keeps one parser per language.
+// Parsers are expensive to create, this allows all documents of the same language to share one, instead of each
+// document keeping its own. It is given back to the pool when destroyed, so only keep it for the duration of a parse.
+// The included ranges are reset when it's given back: set them again before each parse.
+class PooledParser
+{
+public:
+    explicit PooledParser(Core::Document::Type type);
+    ~PooledParser();
+
+    PooledParser(const PooledParser &) = delete;
+    PooledParser &operator=(const PooledParser &) = delete;
+
+    Parser &operator*() { return *m_parser; }
+    Parser *operator->() { return &m_parser.value(); }
+
+private:
+    Core::Document::Type m_type;
+    std::optional<Parser> m_parser;
+};
+
 } // namespace treesitter
@@ -34,6 +34,30 @@ QString QString_no_whitespace(const QString &string)
     return simplified;
 }
 
+bool QStringView_equal(QStringView left, QStringView right)
+{
+    return left == right;
+}
+
+// Same as comparing the results of QString_no_whitespace, without allocating new strings.
+bool QStringView_equal_no_whitespace(QStringView left, QStringView right)
+{
+    auto leftIt = left.cbegin();
+    auto rightIt = right.cbegin();
+    while (true) {
+        while (leftIt != left.cend() && leftIt->isSpace())
+            ++leftIt;
+        while (rightIt != right.cend() && rightIt->isSpace())
+            ++rightIt;
+        if (leftIt == left.cend() || rightIt == right.cend())
+            return leftIt == left.cend() && rightIt == right.cend();
+        if (*leftIt != *rightIt)
+            return false;
+        ++leftIt;
+        ++rightIt;
+    }
+}
+
 Predicates::Filters Predicates::filters()
 {
     Predicates::Filters filters;
@@ -83,18 +107,39 @@ std::optional<QString> Predicates::checkPredicate(const Query::Predicate &predic
     return "Unknown predicate";
 }
 
-Predicates::Predicates(QString source)
+std::optional<QRegularExpression> Predicates::regularExpression(const Query::Predicate &predicate)
+{
+    if (predicate.name != "match?" || predicate.arguments.isEmpty()) {
+        return {};
+    }
+
+    if (const auto regexString = std::get_if<QString>(&predicate.arguments.first())) {
+        QRegularExpression regex(*regexString);
+        // Compile (and JIT) the regex now, so it's not done when the first match is checked.
+        regex.optimize();
+        return regex;
+    }
+    return {};
+}
+
+Predicates::Predicates(QString source, Parameters parameters)
     : m_source(std::move(source))
+    , m_parameters(std::move(parameters))
 {
 }
 
-void Predicates::executeCommands(QueryMatch &match) const
+const QVector<Query::Predicate> &Predicates::predicates(const QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
+    if (!m_boundPredicates.isEmpty()) {
+        return m_boundPredicates.at(match.patternIndex());
+    }
+    return match.query()->patterns().at(match.patternIndex()).predicates;
+}
 
-    for (const auto &predicate : pattern.predicates) {
-        const auto commands = Predicates::commands();
+void Predicates::executeCommands(QueryMatch &match) const
+{
+    static const auto commands = Predicates::commands();
+    for (const auto &predicate : predicates(match)) {
         const auto it = commands.commandFunctions.find(predicate.name);
         if (it != commands.commandFunctions.cend()) {
             const auto commandPredicate = it->second;
@@ -105,11 +150,8 @@ void Predicates::executeCommands(QueryMatch &match) const
 
 bool Predicates::filterMatch(const QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
-
-    for (const auto &predicate : pattern.predicates) {
-        const auto filters = Predicates::filters();
+    static const auto filters = Predicates::filters();
+    for (const auto &predicate : predicates(match)) {
         const auto it = filters.filterFunctions.find(predicate.name);
         if (it != filters.filterFunctions.cend()) {
             const auto filterPredicate = it->second;
@@ -182,33 +224,41 @@ std::optional<QString> Predicates::checkFilter_eq(const Predicates::PredicateArg
     return {};
 }
 bool Predicates::filter_eq_with(const QueryMatch &match, const QList<std::variant<Query::Capture, QString>> &arguments,
-                                const std::function<QString(const QString &)> &textTransform) const
+                                const std::function<bool(QStringView, QStringView)> &textEqual) const
 {
-    std::set<QString> texts;
+    // Captures are compared using views into the source, so no text is copied.
+    std::optional<QStringView> firstText;
+    bool equal = true;
 
     const auto matched = matchArguments(match, arguments);
     for (const auto &arg : matched) {
+        QStringView text;
         if (const auto *capture = std::get_if<QueryMatch::Capture>(&arg)) {
-            texts.emplace(textTransform(capture->node.textIn(m_source)));
+            text = capture->node.textViewIn(m_source);
         } else if (const auto *string = std::get_if<QString>(&arg)) {
-            texts.emplace(textTransform(*string));
+            text = *string;
         } else if (std::holds_alternative<MissingCapture>(arg)) {
             spdlog::warn("Predicates: #eq? - Unmatched capture!");
-            // Insert an empty string into the set if we find an unmatched capture.
+            // Use an empty string if we find an unmatched capture.
             // This likely means we have encountered a quantified capture that matched 0 times.
-            // By inserting an empty string, we can check that all other things are also "empty".
-            texts.emplace("");
+            // By using an empty string, we can check that all other things are also "empty".
         } else {
             spdlog::warn("Predicates: #eq? - Impossible argument type!");
             return false;
         }
+
+        if (!firstText.has_value()) {
+            firstText = text;
+        } else if (equal) {
+            equal = textEqual(*firstText, text);
+        }
     }
-    return texts.size() == 1;
+    return firstText.has_value() && equal;
 }
 
 bool Predicates::filter_eq(const QueryMatch &match, const QList<std::variant<Query::Capture, QString>> &arguments) const
 {
-    return filter_eq_with(match, arguments, QString_identity);
+    return filter_eq_with(match, arguments, QStringView_equal);
 }
 
 std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::PredicateArguments &arguments)
@@ -240,7 +290,7 @@ std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::Predi
 bool Predicates::filter_like(const QueryMatch &match,
                              const QList<std::variant<Query::Capture, QString>> &arguments) const
 {
-    return filter_eq_with(match, arguments, QString_no_whitespace);
+    return filter_eq_with(match, arguments, QStringView_equal_no_whitespace);
 }
 bool Predicates::filter_eq_except_with(const QueryMatch &match,
                                        const QList<std::variant<Query::Capture, QString>> &arguments,
@@ -390,7 +440,8 @@ bool Predicates::filter_match(const QueryMatch &match,
     }
 
     if (const auto regexString = std::get_if<QString>(&matched.first())) {
-        const QRegularExpression regex(*regexString);
+        // The regex was already compiled with the query, don't do it again for each match.
+        const auto regex = match.query()->regularExpression(*regexString);
         if (!regex.isValid()) {
             spdlog::warn("Predicates: #match? - Invalid regex");
             return false;
@@ -398,8 +449,7 @@ bool Predicates::filter_match(const QueryMatch &match,
 
         for (const auto &argument : matched | std::views::drop(1)) {
             if (const auto *capture = std::get_if<QueryMatch::Capture>(&argument)) {
-                auto source = capture->node.textIn(m_source);
-                if (!regex.match(source).hasMatch()) {
+                if (!regex.matchView(capture->node.textViewIn(m_source)).hasMatch()) {
                     return false;
                 }
             } else if (std::holds_alternative<MissingCapture>(argument)) {
@@ -549,8 +599,29 @@ Predicates::matchArguments(const QueryMatch &match, const Predicates::PredicateA
     return result;
 }
 
-void Predicates::setRootNode(const Node &node)
+void Predicates::setQuery(const Query &query, const Node &node)
 {
     m_rootNode = node;
+
+    // Bind the parameters once, instead of for each predicate of each match.
+    m_boundPredicates.clear();
+    if (m_parameters.isEmpty()) {
+        return;
+    }
+    m_boundPredicates.reserve(query.patterns().size());
+    for (const auto &pattern : query.patterns()) {
+        auto bound = pattern.predicates;
+        for (auto &predicate : bound) {
+            for (auto &argument : predicate.arguments) {
+                if (const auto *string = std::get_if<QString>(&argument); string && string->startsWith('$')) {
+                    const auto it = m_parameters.constFind(string->mid(1));
+                    if (it != m_parameters.cend()) {
+                        argument = *it;
+                    }
+                }
+            }
+        }
+        m_boundPredicates.push_back(std::move(bound));
+    }
 }
 }
@@ -13,6 +13,8 @@
 #include "node.h"
 #include "query.h"
 
+#include <QHash>
+#include <QRegularExpression>
 #include <QString>
 
 namespace treesitter {
@@ -55,11 +57,20 @@ class Predicates
     static Commands commands();
 
 public:
-    explicit Predicates(QString source);
+    // Values of the parameters of a query template, by parameter name.
+    using Parameters = QHash<QString, QString>;
+
+    // String arguments written as "$name" in the query are replaced by the value of the `name` parameter.
+    // This way a query template is only compiled once, whatever the values it is used with.
+    explicit Predicates(QString source, Parameters parameters = {});
 
     // Returns an error message if the predicate is not supported
     static std::optional<QString> checkPredicate(const Query::Predicate &predicate);
 
+    // Returns the compiled regular expression used by the predicate, if any.
+    // Called once per predicate when the Query is constructed, see Query::regularExpression.
+    static std::optional<QRegularExpression> regularExpression(const Query::Predicate &predicate);
+
     // Executes all command-predicates (e.g. exclude!) on the match.
     void executeCommands(QueryMatch &match) const;
 
@@ -90,7 +101,7 @@ private:
 #undef PREDICATE_FILTER
 
     bool filter_eq_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
-                        const std::function<QString(const QString &)> &textTransform) const;
+                        const std::function<bool(QStringView, QStringView)> &textEqual) const;
     bool filter_eq_except_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
                                const std::function<QString(const QString &)> &textTransform) const;
 
@@ -124,10 +135,17 @@ private:
 
     // ################## Context data #########################
     friend class QueryCursor;
-    void setRootNode(const Node &node);
+    // Called by the QueryCursor before running the `query` on the `node`.
+    void setQuery(const Query &query, const Node &node);
+
+    // The predicates of the pattern of the match, with the parameters bound.
+    const QVector<Query::Predicate> &predicates(const QueryMatch &match) const;
 
     const QString m_source;
+    const Parameters m_parameters;
     std::optional<Node> m_rootNode;
+    // Predicates of each pattern of the query, with the parameters bound. Empty if there are no parameters.
+    QVector<QVector<Query::Predicate>> m_boundPredicates;
 };
 
 }
@@ -15,6 +15,7 @@
 #include <QStringList>
 #include <kdalgorithms.h>
 #include <tree_sitter/api.h>
+#include <vector>
 
 namespace treesitter {
 
@@ -36,8 +37,17 @@ Query::Query(const TSLanguage *language, const QString &query)
         };
     }
 
-    const auto patterns = this->patterns();
-    for (const auto &pattern : patterns) {
+    // The patterns are needed for every match, so only compute them once.
+    auto count = ts_query_pattern_count(m_query);
+    m_patterns.reserve(count);
+    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
+        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
+        auto predicates = predicatesForPattern(patternIndex);
+
+        m_patterns.emplace_back(Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte});
+    }
+
+    for (const auto &pattern : std::as_const(m_patterns)) {
         for (const auto &predicate : pattern.predicates) {
             auto error = Predicates::checkPredicate(predicate);
             if (error.has_value()) {
@@ -45,14 +55,33 @@ Query::Query(const TSLanguage *language, const QString &query)
                 auto offset = m_utf8_text.indexOf(predicateString);
                 offset = offset >= 0 ? offset : 0;
 
+                ts_query_delete(m_query);
                 throw Error {.utf8_offset = static_cast<uint32_t>(offset), .description = error.value()};
             }
+
+            if (auto regex = Predicates::regularExpression(predicate)) {
+                m_regularExpressions.insert(regex->pattern(), *regex);
+            }
         }
     }
+
+    const auto captureCount = ts_query_capture_count(m_query);
+    m_captureNames.reserve(captureCount);
+    for (uint32_t id = 0; id < captureCount; ++id) {
+        uint32_t length;
+        auto name = ts_query_capture_name_for_id(m_query, id, &length);
+        m_captureNames.emplace_back(QString::fromUtf8(name, length));
+        m_captureIds.insert(m_captureNames.back(), id);
+    }
 }
 
 Query::Query(Query &&other) noexcept
-    : m_query(other.m_query)
+    : m_utf8_text(std::move(other.m_utf8_text))
+    , m_query(other.m_query)
+    , m_patterns(std::move(other.m_patterns))
+    , m_regularExpressions(std::move(other.m_regularExpressions))
+    , m_captureNames(std::move(other.m_captureNames))
+    , m_captureIds(std::move(other.m_captureIds))
 {
     other.m_query = nullptr;
 }
@@ -72,7 +101,12 @@ Query &Query::operator=(Query &&other) noexcept
 
 void Query::swap(Query &other) noexcept
 {
+    std::swap(m_utf8_text, other.m_utf8_text);
     std::swap(m_query, other.m_query);
+    std::swap(m_patterns, other.m_patterns);
+    std::swap(m_regularExpressions, other.m_regularExpressions);
+    std::swap(m_captureNames, other.m_captureNames);
+    std::swap(m_captureIds, other.m_captureIds);
 }
 
 QList<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
@@ -110,37 +144,40 @@ QList<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
     return predicates;
 }
 
-QList<Query::Pattern> Query::patterns() const
+const QList<Query::Pattern> &Query::patterns() const
 {
-    QList<Query::Pattern> result;
-
-    auto count = ts_query_pattern_count(m_query);
-    result.reserve(count);
-    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
-        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
-        auto predicates = predicatesForPattern(patternIndex);
+    return m_patterns;
+}
 
-        result.emplace_back(Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte});
+QRegularExpression Query::regularExpression(const QString &pattern) const
+{
+    if (auto it = m_regularExpressions.constFind(pattern); it != m_regularExpressions.cend()) {
+        return it.value();
     }
-    return result;
+    return QRegularExpression(pattern);
 }
 
 QList<Query::Capture> Query::captures() const
 {
-    uint32_t length = ts_query_capture_count(m_query);
-
     QList<Query::Capture> results;
-    for (uint32_t i = 0; i < length; i++) {
+    results.reserve(m_captureNames.size());
+    for (uint32_t i = 0; i < static_cast<uint32_t>(m_captureNames.size()); i++) {
         results.emplace_back(captureAt(i));
     }
     return results;
 }
+
 Query::Capture Query::captureAt(uint32_t index) const
 {
-    uint32_t length;
-    auto name = ts_query_capture_name_for_id(m_query, index, &length);
+    return Capture {.name = m_captureNames.at(index), .id = index};
+}
 
-    return Capture {.name = QString(name), .id = index};
+std::optional<uint32_t> Query::captureId(const QString &name) const
+{
+    if (auto it = m_captureIds.constFind(name); it != m_captureIds.cend()) {
+        return it.value();
+    }
+    return {};
 }
 
 // ------------------------ QueryMatch --------------------
@@ -180,12 +217,11 @@ std::shared_ptr<Query> QueryMatch::query() const
 
 QList<QueryMatch::Capture> QueryMatch::capturesNamed(const QString &name) const
 {
-    auto captures = this->captures();
-    QList<Capture> result;
-    std::ranges::copy_if(std::as_const(captures), std::back_inserter(result), [this, &name](const auto &capture) {
-        return m_query->captureAt(capture.id).name == name;
-    });
-    return result;
+    const auto id = m_query->captureId(name);
+    if (!id) {
+        return {};
+    }
+    return capturesWithId(*id);
 }
 
 void QueryMatch::setCaptures(QList<Capture> &&captures)
@@ -206,22 +242,79 @@ QList<QueryMatch::Capture> QueryMatch::capturesWithId(uint32_t id) const
 }
 
 // ----------------------- QueryCursor --------------------
+namespace {
+
+// TSQueryCursor keeps its buffers (e.g. for the captures and in-progress matches) between executions.
+// Lots of queries are run one after the other (e.g. to find symbols), so reuse the cursors instead of
+// allocating new ones each time.
+// The pool is per thread, so no locking is needed.
+class QueryCursorPool
+{
+public:
+    ~QueryCursorPool()
+    {
+        for (auto *cursor : m_cursors) {
+            ts_query_cursor_delete(cursor);
+        }
+    }
+
+    static QueryCursorPool &local()
+    {
+        thread_local QueryCursorPool pool;
+        return pool;
+    }
+
+    TSQueryCursor *take()
+    {
+        if (m_cursors.empty()) {
+            return ts_query_cursor_new();
+        }
+        auto *cursor = m_cursors.back();
+        m_cursors.pop_back();
+        return cursor;
+    }
+
+    void release(TSQueryCursor *cursor)
+    {
+        if (m_cursors.size() >= MaxSize) {
+            ts_query_cursor_delete(cursor);
+            return;
+        }
+        // Reset what QueryCursor may have changed, the rest is reset by ts_query_cursor_exec.
+        ts_query_cursor_set_byte_range(cursor, 0, UINT32_MAX);
+        ts_query_cursor_set_match_limit(cursor, UINT32_MAX);
+        m_cursors.push_back(cursor);
+    }
+
+private:
+    // Cursors are usually short-lived, so only a few of them exist at the same time.
+    static constexpr size_t MaxSize = 8;
+    std::vector<TSQueryCursor *> m_cursors;
+};
+
+}
+
 QueryCursor::QueryCursor()
-    : m_cursor(ts_query_cursor_new())
+    : m_cursor(QueryCursorPool::local().take())
 {
 }
 
 QueryCursor::~QueryCursor()
 {
     if (m_cursor) {
-        ts_query_cursor_delete(m_cursor);
+        QueryCursorPool::local().release(m_cursor);
     }
 }
 
 QueryCursor::QueryCursor(QueryCursor &&other) noexcept
     : m_query(std::move(other.m_query))
+    , m_progressCallback(std::move(other.m_progressCallback))
     , m_predicates(std::move(other.m_predicates))
     , m_cursor(std::move(other.m_cursor))
+    , m_limits(other.m_limits)
+    , m_deadline(other.m_deadline)
+    , m_matchCount(other.m_matchCount)
+    , m_truncation(other.m_truncation)
 {
     other.m_cursor = nullptr;
 }
@@ -234,19 +327,51 @@ QueryCursor &QueryCursor::operator=(QueryCursor &&other) noexcept
 
 void QueryCursor::swap(QueryCursor &other) noexcept
 {
+    std::swap(m_query, other.m_query);
+    std::swap(m_progressCallback, other.m_progressCallback);
+    std::swap(m_predicates, other.m_predicates);
     std::swap(m_cursor, other.m_cursor);
+    std::swap(m_limits, other.m_limits);
+    std::swap(m_deadline, other.m_deadline);
+    std::swap(m_matchCount, other.m_matchCount);
+    std::swap(m_truncation, other.m_truncation);
 }
 
 void QueryCursor::execute(std::shared_ptr<Query> query, const Node &node, std::unique_ptr<Predicates> &&predicates)
 {
     m_predicates = std::move(predicates);
+    m_query = std::move(query);
     if (m_predicates) {
-        m_predicates->setRootNode(node);
+        m_predicates->setQuery(*m_query, node);
     }
-    m_query = std::move(query);
+    m_deadline = m_limits.timeout > 0 ? QDeadlineTimer(m_limits.timeout) : QDeadlineTimer(QDeadlineTimer::Forever);
+    m_matchCount = 0;
+    m_truncation = Truncation::None;
     ts_query_cursor_exec(m_cursor, m_query->m_query, node.m_node);
 }
 
+void QueryCursor::setLimits(const Limits &limits)
+{
+    m_limits = limits;
+    ts_query_cursor_set_match_limit(m_cursor, limits.matchLimit > 0 ? limits.matchLimit : UINT32_MAX);
+}
+
+QueryCursor::Truncation QueryCursor::truncation() const
+{
+    if (m_truncation != Truncation::None) {
+        return m_truncation;
+    }
+    if (m_cursor && ts_query_cursor_did_exceed_match_limit(m_cursor)) {
+        return Truncation::MatchLimit;
+    }
+    return Truncation::None;
+}
+
+void QueryCursor::setRange(uint32_t start, uint32_t end)
+{
+    ts_query_cursor_set_byte_range(m_cursor, start * sizeof(QChar), end * sizeof(QChar));
+}
+
 void QueryCursor::setProgressCallback(std::function<void()> callback)
 {
     m_progressCallback = std::move(callback);
@@ -254,24 +379,40 @@ void QueryCursor::setProgressCallback(std::function<void()> callback)
 
 std::optional<QueryMatch> QueryCursor::nextMatch()
 {
+    if (m_truncation != Truncation::None) {
+        return {};
+    }
+
     TSQueryMatch match;
 
-    while (ts_query_cursor_next_match(m_cursor, &match)) {
+    while (true) {
+        if (m_deadline.hasExpired()) {
+            m_truncation = Truncation::Timeout;
+            return {};
+        }
+        if (!ts_query_cursor_next_match(m_cursor, &match)) {
+            return {};
+        }
+
         QueryMatch result(match, m_query);
         if (m_predicates) {
             m_predicates->executeCommands(result);
-            if (m_predicates->filterMatch(result)) {
-                return result;
+            if (!m_predicates->filterMatch(result)) {
+                if (m_progressCallback) {
+                    m_progressCallback();
+                }
+                continue;
             }
-        } else {
-            return result;
         }
 
-        if (m_progressCallback) {
-            m_progressCallback();
+        // Only report the truncation if there actually is another match.
+        if (m_limits.maxMatches > 0 && m_matchCount >= m_limits.maxMatches) {
+            m_truncation = Truncation::MaxMatches;
+            return {};
         }
+        ++m_matchCount;
+        return result;
     }
-    return {};
 }
 
 QList<QueryMatch> QueryCursor::allRemainingMatches()
@@ -13,9 +13,14 @@
 #include "node.h"
 
 #include <QByteArray>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QRegularExpression>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 #include <functional>
+#include <optional>
 #include <tree_sitter/api.h>
 
 struct TSLanguage;
@@ -67,16 +72,27 @@ public:
 
     void swap(Query &other) noexcept;
 
-    QVector<Pattern> patterns() const;
+    const QVector<Pattern> &patterns() const;
 
     QVector<Capture> captures() const;
     Capture captureAt(uint32_t index) const;
+    // Returns the id of the capture with this name, if the query has one.
+    std::optional<uint32_t> captureId(const QString &name) const;
+
+    // Returns the regular expression used by a predicate (e.g. #match?) of this query.
+    // All of them are compiled and optimized once, when the query is constructed.
+    QRegularExpression regularExpression(const QString &pattern) const;
 
 private:
     QVector<Predicate> predicatesForPattern(uint32_t index) const;
 
     QByteArray m_utf8_text;
     TSQuery *m_query;
+    QVector<Pattern> m_patterns;
+    QHash<QString, QRegularExpression> m_regularExpressions;
+    // Indexed by capture id, names are needed for every capture of every match.
+    QStringList m_captureNames;
+    QHash<QString, uint32_t> m_captureIds;
 
     friend class QueryCursor;
 };
@@ -125,6 +141,26 @@ private:
 class QueryCursor
 {
 public:
+    struct Limits
+    {
+        // Maximum number of in-progress matches, see ts_query_cursor_set_match_limit. 0 for no limit.
+        // If exceeded, TreeSitter drops the oldest in-progress matches, so some matches may be missing.
+        uint32_t matchLimit = 0;
+        // Maximum time spent in the query (in milliseconds) since execute was called. 0 for no limit.
+        // Only checked between two matches.
+        int timeout = 0;
+        // Maximum number of matches returned. 0 for no limit.
+        int maxMatches = 0;
+    };
+
+    // Why not all matches were returned, see Limits.
+    enum class Truncation {
+        None,
+        MatchLimit,
+        Timeout,
+        MaxMatches,
+    };
+
     QueryCursor();
 
     QueryCursor(const QueryCursor &) = delete;
@@ -139,6 +175,17 @@ public:
 
     void execute(std::shared_ptr<Query> query, const Node &node, std::unique_ptr<Predicates> &&predicates);
 
+    // Only search for matches that intersect the given range (in characters, like Node::startPosition).
+    // This avoids walking the parts of the tree outside of the range, but note that the matches
+    // may still extend beyond the range.
+    // Must be called before execute. The range is kept for all following executions.
+    void setRange(uint32_t start, uint32_t end);
+
+    // Must be called before execute. The limits are kept for all following executions.
+    void setLimits(const Limits &limits);
+    // Only reliable once nextMatch returned no match.
+    Truncation truncation() const;
+
     std::optional<QueryMatch> nextMatch();
 
     // Get all remaining matches.
@@ -158,6 +205,11 @@ private:
 
     std::unique_ptr<Predicates> m_predicates;
     TSQueryCursor *m_cursor;
+
+    Limits m_limits;
+    QDeadlineTimer m_deadline {QDeadlineTimer::Forever};
+    int m_matchCount = 0;
+    Truncation m_truncation = Truncation::None;
 };
 
 using QueryList = QVector<std::shared_ptr<Query>>;
@@ -0,0 +1,98 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "query_cache.h"
+
+#include <QMutexLocker>
+
+namespace treesitter {
+
+QueryCache &QueryCache::instance()
+{
+    static QueryCache cache;
+    return cache;
+}
+
+QueryCache::QueryCache(qsizetype capacity)
+    : m_capacity(capacity)
+{
+}
+
+std::shared_ptr<Query> QueryCache::query(const TSLanguage *language, const QString &query)
+{
+    Key key {.language = language, .query = query};
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (auto it = m_index.constFind(key); it != m_index.cend()) {
+            ++m_hits;
+            // Move the entry to the front, it's now the most recently used one.
+            m_entries.splice(m_entries.begin(), m_entries, it.value());
+            return m_entries.front().query;
+        }
+        ++m_misses;
+    }
+
+    // Compile outside of the lock, this is the expensive part.
+    // May throw a Query::Error, in which case nothing is cached.
+    auto compiled = std::make_shared<Query>(language, query);
+
+    QMutexLocker locker(&m_mutex);
+    if (auto it = m_index.constFind(key); it != m_index.cend()) {
+        // Another thread compiled the same query in the meantime, share that one.
+        m_entries.splice(m_entries.begin(), m_entries, it.value());
+        return m_entries.front().query;
+    }
+
+    m_entries.push_front(Entry {.key = key, .query = compiled});
+    m_index.insert(std::move(key), m_entries.begin());
+    evict();
+
+    return compiled;
+}
+
+qsizetype QueryCache::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capacity;
+}
+
+void QueryCache::setCapacity(qsizetype capacity)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = capacity;
+    evict();
+}
+
+QueryCache::Statistics QueryCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return Statistics {.hits = m_hits, .misses = m_misses, .size = static_cast<qsizetype>(m_entries.size())};
+}
+
+void QueryCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_index.clear();
+    m_entries.clear();
+    m_hits = 0;
+    m_misses = 0;
+}
+
+void QueryCache::evict()
+{
+    // Evicted queries stay alive as long as they are still used somewhere, e.g. by a QueryMatch.
+    while (static_cast<qsizetype>(m_entries.size()) > m_capacity) {
+        m_index.remove(m_entries.back().key);
+        m_entries.pop_back();
+    }
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "query.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <list>
+#include <memory>
+
+struct TSLanguage;
+
+namespace treesitter {
+
+// Compiling a query (ts_query_new) is expensive, and scripts tend to run the same query over and over again,
+// often on many different documents.
+// The QueryCache keeps the most recently used compiled queries around, so they can be shared by all documents
+// of the same language.
+//
+// Compiled queries are immutable, so it's safe to share them.
+class QueryCache
+{
+public:
+    struct Statistics
+    {
+        qsizetype hits = 0;
+        qsizetype misses = 0;
+        qsizetype size = 0;
+    };
+
+    static constexpr qsizetype DefaultCapacity = 256;
+
+    static QueryCache &instance();
+
+    explicit QueryCache(qsizetype capacity = DefaultCapacity);
+
+    QueryCache(const QueryCache &) = delete;
+    QueryCache &operator=(const QueryCache &) = delete;
+
+    // Returns the compiled query, either from the cache, or by compiling it.
+    // throws a Query::Error if the query is ill-formed, failed queries are not cached.
+    std::shared_ptr<Query> query(const TSLanguage *language, const QString &query);
+
+    qsizetype capacity() const;
+    void setCapacity(qsizetype capacity);
+
+    Statistics statistics() const;
+    void clear();
+
+private:
+    struct Key
+    {
+        const TSLanguage *language;
+        QString query;
+
+        bool operator==(const Key &other) const = default;
+        friend size_t qHash(const Key &key, size_t seed = 0) { return qHashMulti(seed, key.language, key.query); }
+    };
+
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<Query> query;
+    };
+
+    void evict();
+
+    mutable QMutex m_mutex;
+    qsizetype m_capacity;
+    // Most recently used entries are at the front.
+    std::list<Entry> m_entries;
+    QHash<Key, std::list<Entry>::iterator> m_index;
+    qsizetype m_hits = 0;
+    qsizetype m_misses = 0;
+};
+
+}
@@ -11,6 +11,7 @@
 #include "tree.h"
 
 #include <tree_sitter/api.h>
+#include <cstdlib>
 #include <utility>
 
 namespace treesitter {
@@ -49,4 +50,23 @@ Node Tree::rootNode() const
     return Node(ts_tree_root_node(m_tree));
 }
 
+Tree Tree::copy() const
+{
+    return Tree(ts_tree_copy(m_tree));
+}
+
+void Tree::edit(const InputEdit &edit)
+{
+    ts_tree_edit(m_tree, &edit);
+}
+
+QList<Range> Tree::changedRanges(const Tree &newTree) const
+{
+    uint32_t count = 0;
+    TSRange *ranges = ts_tree_get_changed_ranges(m_tree, newTree.m_tree, &count);
+    QList<Range> result(ranges, ranges + count);
+    free(ranges);
+    return result;
+}
+
 }
@@ -12,12 +12,17 @@
 
 #include "node.h"
 
+#include <QList>
+
 struct TSTree;
 
 namespace treesitter {
 
 class Parser;
 
+using InputEdit = TSInputEdit;
+using Range = TSRange;
+
 class Tree
 {
 public:
@@ -31,6 +36,18 @@ public:
 
     Node rootNode() const;
 
+    // Returns a shallow copy of the tree, this is cheap. Each thread must use its own copy of a tree.
+    Tree copy() const;
+
+    // Adjusts the tree to the given edit of the source text, so it can be passed to Parser::parseString
+    // as the old tree for incremental parsing.
+    // Note: Nodes retrieved from this tree before the edit are not updated!
+    void edit(const InputEdit &edit);
+
+    // Returns the ranges whose syntactic structure differs in `newTree`, which must have been parsed from this
+    // (edited) tree. Text changes that keep the same structure (e.g. renaming an identifier) are not included.
+    QList<Range> changedRanges(const Tree &newTree) const;
+
     void swap(Tree &other) noexcept;
 
 private:
@@ -39,9 +56,6 @@ private:
     TSTree *m_tree;
 
     friend class Parser;
-
-    // TODO: Once update is implemented, store weak pointers to all
-    // TSNodes so that they may be updated as well.
 };
 
 }
@@ -20,6 +20,11 @@ TreeCursor::TreeCursor(Node node)
     m_cursor = ts_tree_cursor_new(node.m_node);
 }
 
+TreeCursor::~TreeCursor()
+{
+    ts_tree_cursor_delete(&m_cursor);
+}
+
 Node TreeCursor::currentNode() const
 {
     return ts_tree_cursor_current_node(&m_cursor);
@@ -36,6 +41,11 @@ bool TreeCursor::gotoFirstChild()
     return ts_tree_cursor_goto_first_child(&m_cursor);
 }
 
+bool TreeCursor::gotoFirstChildForPosition(uint32_t position)
+{
+    return ts_tree_cursor_goto_first_child_for_byte(&m_cursor, position * sizeof(QChar)) != -1;
+}
+
 bool TreeCursor::gotoNextSibling()
 {
     return ts_tree_cursor_goto_next_sibling(&m_cursor);
@@ -46,4 +56,70 @@ bool TreeCursor::gotoParent()
     return ts_tree_cursor_goto_parent(&m_cursor);
 }
 
+NodeRange::NodeRange(const Node &node, Kind kind)
+    : m_cursor(node)
+    , m_kind(kind)
+{
+    m_atEnd = !m_cursor.gotoFirstChild();
+    if (!m_atEnd && m_kind == Kind::NamedChildren && !m_cursor.currentNode().isNamed())
+        advance();
+}
+
+NodeRange NodeRange::children(const Node &node)
+{
+    return NodeRange(node, Kind::Children);
+}
+
+NodeRange NodeRange::namedChildren(const Node &node)
+{
+    return NodeRange(node, Kind::NamedChildren);
+}
+
+NodeRange NodeRange::descendants(const Node &node)
+{
+    return NodeRange(node, Kind::Descendants);
+}
+
+void NodeRange::skipChildren()
+{
+    m_skipChildren = true;
+}
+
+void NodeRange::advance()
+{
+    if (m_atEnd)
+        return;
+
+    switch (m_kind) {
+    case Kind::Children:
+        m_atEnd = !m_cursor.gotoNextSibling();
+        break;
+    case Kind::NamedChildren:
+        do {
+            m_atEnd = !m_cursor.gotoNextSibling();
+        } while (!m_atEnd && !m_cursor.currentNode().isNamed());
+        break;
+    case Kind::Descendants:
+        if (!m_skipChildren && m_cursor.gotoFirstChild()) {
+            ++m_depth;
+        } else {
+            m_atEnd = !gotoNext();
+        }
+        m_skipChildren = false;
+        break;
+    }
+}
+
+bool NodeRange::gotoNext()
+{
+    // Never leave the node of the range: depth 0 is the node itself.
+    while (m_depth > 0) {
+        if (m_cursor.gotoNextSibling())
+            return true;
+        m_cursor.gotoParent();
+        --m_depth;
+    }
+    return false;
+}
+
 }
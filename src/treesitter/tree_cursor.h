@@ -12,6 +12,8 @@
 
 #include "node.h"
 
+#include <iterator>
+
 namespace treesitter {
 
 class TreeCursor
@@ -20,16 +22,89 @@ public:
     TreeCursor(Node);
     TreeCursor(const TreeCursor &) = delete;
     TreeCursor(TreeCursor &&) = delete;
+    ~TreeCursor();
 
     Node currentNode() const;
     /// This returns a null QString if there is no field name
     QString currentFieldName() const;
 
     bool gotoFirstChild();
+    // Moves to the first child that extends beyond the given position (in characters, like Node::startPosition).
+    bool gotoFirstChildForPosition(uint32_t position);
     bool gotoNextSibling();
     bool gotoParent();
 
 private:
     TSTreeCursor m_cursor;
 };
+
+/**
+ * Range over the children, the named children or the descendants (in pre-order) of a node.
+ *
+ * All nodes are visited with a single TreeCursor, so contrary to Node::children and Node::namedChildren nothing is
+ * allocated while iterating, and going to the next child doesn't need to look for it from the parent again.
+ * The range can only be iterated once, and neither the range nor its nodes can be used once the tree is edited.
+ *
+ * ```cpp
+ * for (const auto &child : NodeRange::namedChildren(node)) { ... }
+ * ```
+ */
+class NodeRange
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Node *;
+        using reference = Node;
+
+        Node operator*() const { return m_range->m_cursor.currentNode(); }
+        iterator &operator++()
+        {
+            m_range->advance();
+            return *this;
+        }
+        void operator++(int) { m_range->advance(); }
+        bool operator==(std::default_sentinel_t) const { return m_range->m_atEnd; }
+
+    private:
+        friend NodeRange;
+        explicit iterator(NodeRange *range)
+            : m_range(range)
+        {
+        }
+
+        NodeRange *m_range;
+    };
+
+    static NodeRange children(const Node &node);
+    static NodeRange namedChildren(const Node &node);
+    // All nodes below the given one (but not the node itself), parents first.
+    static NodeRange descendants(const Node &node);
+
+    iterator begin() { return iterator(this); }
+    std::default_sentinel_t end() const { return {}; }
+
+    // For descendants only: the children of the current node are not visited.
+    void skipChildren();
+
+private:
+    enum class Kind { Children, NamedChildren, Descendants };
+    NodeRange(const Node &node, Kind kind);
+
+    void advance();
+    // Moves to the next node of the range, without going into the children of the current one.
+    bool gotoNext();
+
+    TreeCursor m_cursor;
+    const Kind m_kind;
+    // Depth of the current node, relative to the node of the range: the range starts on its first child.
+    uint32_t m_depth = 1;
+    bool m_atEnd = false;
+    bool m_skipChildren = false;
+};
+
 }
@@ -14,8 +14,13 @@
 #include "core/lsp_utils.h"
 #include "core/project.h"
 #include "core/querymatch.h"
+#include "core/querymatchiterator.h"
+#include "core/settings.h"
+#include "treesitter/languages.h"
+#include "treesitter/query_cache.h"
 
 #include <QAction>
+#include <QJSEngine>
 #include <QPlainTextEdit>
 #include <QSignalSpy>
 #include <QTemporaryFile>
@@ -107,6 +112,200 @@ private slots:
         verifySymbol(headerDocument, headerSymbols.at(10), "MyObject::m_enum", Core::Symbol::Kind::Field, "m_enum");
     }
 
+    void benchmarkSymbols()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto headerDocument = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+        const auto header = headerDocument->text();
+
+        // 200 classes, with 11 symbols each
+        QString source;
+        for (int i = 0; i < 200; ++i) {
+            source += QString(header).replace("MyObject", QString("MyObject%1").arg(i));
+        }
+        headerDocument->setText(source);
+        QCOMPARE(headerDocument->symbols().size(), 11 * 200);
+
+        QBENCHMARK {
+            // Any change invalidates the symbols
+            headerDocument->insertAtPosition(" ", 0);
+            QCOMPARE(headerDocument->symbols().size(), 11 * 200);
+        }
+    }
+
+    void benchmarkSymbolStorage_data()
+    {
+        QTest::addColumn<bool>("createObjects");
+
+        QTest::newRow("table") << false;
+        QTest::newRow("objects") << true;
+    }
+
+    void benchmarkSymbolStorage()
+    {
+        QFETCH(bool, createObjects);
+        INIT_KNUT_PROJECT;
+
+        auto headerDocument = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+        const auto header = headerDocument->text();
+
+        // 200 classes, with 11 symbols each
+        QString source;
+        for (int i = 0; i < 200; ++i) {
+            source += QString(header).replace("MyObject", QString("MyObject%1").arg(i));
+        }
+        headerDocument->setText(source);
+
+        QBENCHMARK {
+            // Any change invalidates the symbols
+            headerDocument->insertAtPosition(" ", 0);
+            if (createObjects)
+                QCOMPARE(headerDocument->symbols().size(), 11 * 200);
+            else
+                QVERIFY(headerDocument->findSymbol("MyObject199::m_enum", Core::TextDocument::FindWholeWords));
+        }
+
+        // Each Symbol object is a QObject, with its own range marks, the table only holds plain data: looking for a
+        // symbol only creates the Symbol object returned.
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+        QCOMPARE(headerDocument->findChildren<Core::Symbol *>().size(), createObjects ? 11 * 200 : 1);
+    }
+
+    void symbolsAfterEdits()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+        auto symbolsText = [document]() {
+            return kdalgorithms::transformed<QStringList>(document->symbols(), [](const Core::Symbol *symbol) {
+                return QString("%1 %2-%3").arg(symbol->name()).arg(symbol->range().start()).arg(symbol->range().end());
+            });
+        };
+        auto replace = [document](const QString &before, const QString &after) {
+            const auto position = document->text().indexOf(before);
+            QVERIFY(position != -1);
+            document->replace(position, position + before.size(), after);
+        };
+        // The symbols are only queried again where the document changed, they must be the same as when querying
+        // the whole document.
+        auto verifySymbols = [document, &symbolsText]() {
+            const auto symbols = symbolsText();
+            const auto text = document->text();
+            document->setText("");
+            document->setText(text);
+            QCOMPARE(symbols, symbolsText());
+        };
+
+        QCOMPARE(symbolsText().size(), 11);
+
+        replace("    enum class", "    void newMethod();\n\n    enum class");
+        QCOMPARE(symbolsText().size(), 12);
+        verifySymbols();
+
+        // Same structure, only the name changes
+        replace("m_message", "m_text");
+        const auto memberStart = document->text().indexOf("std::string m_text;");
+        QVERIFY(symbolsText().contains(QString("MyObject::m_text %1-%2").arg(memberStart).arg(memberStart + 19)));
+        verifySymbols();
+
+        // Multiple edits between two queries
+        replace("        B = 0x02,\n", "");
+        replace("~MyObject();", "");
+        replace("class MyObject {", "class MyObject : public Base {");
+        QCOMPARE(symbolsText().size(), 10);
+        verifySymbols();
+    }
+
+    void parseInBackground()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+        QSignalSpy readySpy(document, &Core::CodeDocument::syntaxTreeReady);
+
+        document->parseInBackground();
+        QVERIFY(document->isParsingInBackground());
+        QVERIFY(readySpy.wait());
+        QVERIFY(!document->isParsingInBackground());
+        QCOMPARE(document->symbols().size(), 11);
+
+        // Using the tree waits for the background parse
+        document->setText(document->text() + "\nclass Foo {};\n");
+        document->parseInBackground();
+        QCOMPARE(document->symbols().size(), 12);
+        QVERIFY(!document->isParsingInBackground());
+        QVERIFY(readySpy.wait());
+
+        // Edited while parsing, the document is parsed again
+        document->setText(document->text() + "\nclass Bar {};\n");
+        document->parseInBackground();
+        document->setText(document->text() + "\nclass Baz {};\n");
+        readySpy.clear();
+        QVERIFY(readySpy.wait());
+        QCOMPARE(document->symbols().size(), 14);
+    }
+
+    void outdatedSymbols()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+        const auto symbolCount = document->symbols().size();
+        QPointer<Core::Symbol> scriptSymbol = document->symbols().first();
+        QPointer<Core::Symbol> cppSymbol = document->symbols().last();
+        QJSEngine engine;
+        auto value = engine.newQObject(scriptSymbol);
+
+        // Once outdated, the symbols used by a script are given to the JavaScript engine, the other ones are deleted.
+        document->insertAtPosition(" ", 0);
+        QCOMPARE(document->symbols().size(), symbolCount);
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+        QVERIFY(!cppSymbol);
+        QVERIFY(scriptSymbol);
+        QCOMPARE(scriptSymbol->parent(), nullptr);
+        QCOMPARE(QJSEngine::objectOwnership(scriptSymbol), QJSEngine::JavaScriptOwnership);
+        QCOMPARE(value.property("name").toString(), "MyObject");
+        QCOMPARE(document->findChildren<Core::Symbol *>().size(), symbolCount);
+    }
+
+    void benchmarkSymbolContexts_data()
+    {
+        QTest::addColumn<int>("count");
+
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("2000") << 2000;
+        QTest::newRow("4000") << 4000;
+        QTest::newRow("8000") << 8000;
+    }
+
+    void benchmarkSymbolContexts()
+    {
+        QFETCH(int, count);
+
+        INIT_KNUT_PROJECT;
+
+        // A generated header: one class with a single enum, containing all other symbols
+        QStringList enumerators;
+        for (int i = 0; i < count - 2; ++i) {
+            enumerators.push_back(QString("Value%1 = %1").arg(i));
+        }
+        const auto source =
+            QString("class Generated {\n    enum Values {\n        %1\n    };\n};\n").arg(enumerators.join(",\n        "));
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+        document->setText(source);
+        const auto symbols = document->symbols();
+        QCOMPARE(symbols.size(), count);
+        QCOMPARE(symbols.last()->name(), QString("Generated::Values::Value%1").arg(count - 3));
+
+        QBENCHMARK {
+            // Any change invalidates the symbols
+            document->insertAtPosition(" ", 0);
+            QCOMPARE(document->symbols().size(), count);
+        }
+    }
+
     void symbolUnderCursor_data()
     {
         QTest::addColumn<QString>("fileName");
@@ -378,6 +577,33 @@ private slots:
         QCOMPARE(match.getAll("param").at(1).text(), "char *argv[]");
     }
 
+    void queryCapturesAfterEdit()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        auto matches = codedocument->query(R"EOF(
+                (function_definition
+                  type: (_) @return
+                  declarator: (function_declarator
+                    declarator: (identifier) @name))
+                      )EOF");
+        QCOMPARE(matches.size(), 4);
+        QVERIFY(!matches.first().get("unknown").isValid());
+
+        // The ranges are only tracked once used, until then each edit shifts them: both need to stay up to date.
+        const auto name = matches.first().get("name");
+        QCOMPARE(name.text(), "main");
+        codedocument->insertAtPosition("// Hello\n", 0);
+        QCOMPARE(name.text(), "main");
+        QCOMPARE(matches.first().get("return").text(), "int");
+        codedocument->insertAtPosition("// World\n", 0);
+        QCOMPARE(name.text(), "main");
+        QCOMPARE(matches.last().get("name").text(), "freeFunction");
+        QCOMPARE(matches.last().getAllJoined("name").text(), "freeFunction");
+    }
+
     void failedQuery()
     {
         INIT_KNUT_PROJECT;
@@ -401,6 +627,47 @@ private slots:
         QCOMPARE(counter.count(), 1);
     }
 
+    void queryCache()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto main = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        auto myobject = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("myobject.cpp"));
+
+        const auto queryString = "(function_definition) @function ; queryCache";
+        const auto before = treesitter::QueryCache::instance().statistics();
+        QCOMPARE(main->query(queryString).size(), 4);
+        QCOMPARE(myobject->query(queryString).size(), 4);
+        QCOMPARE(main->query(queryString).size(), 4);
+        const auto after = treesitter::QueryCache::instance().statistics();
+
+        // Compiled once, then shared by both documents
+        QCOMPARE(after.misses - before.misses, 1);
+        QCOMPARE(after.hits - before.hits, 2);
+    }
+
+    void maxSyntaxTrees()
+    {
+        INIT_KNUT_PROJECT;
+        SET_DEFAULT_VALUE(TreeSitterMaxSyntaxTrees, 1);
+
+        auto main = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        const auto query = QString("(function_definition) @function");
+        auto iterator = main->createQueryIterator(query);
+        QVERIFY(!iterator->next().isEmpty());
+
+        // Using another document releases the syntax tree of main.cpp, but not the document itself
+        auto myobject = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("myobject.cpp"));
+        QCOMPARE(myobject->query(query).size(), 4);
+        QVERIFY(iterator->next().isEmpty());
+        QVERIFY(iterator->atEnd());
+
+        QCOMPARE(Core::Project::instance()->get("main.cpp"), main);
+        QCOMPARE(main->query(query).size(), 4);
+
+        SET_DEFAULT_VALUE(TreeSitterMaxSyntaxTrees, 100);
+    }
+
     void queryInRange()
     {
         INIT_KNUT_PROJECT;
@@ -421,6 +688,175 @@ private slots:
         QCOMPARE(matches.size(), 2);
     }
 
+    void incrementalParsing()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        auto functionNames = [codedocument]() {
+            const auto matches = codedocument->query(R"EOF(
+                (function_definition
+                  declarator: (function_declarator
+                    declarator: (identifier) @name))
+                )EOF");
+            return kdalgorithms::transformed<QStringList>(matches, [](const auto &match) {
+                return match.get("name").text();
+            });
+        };
+
+        QCOMPARE(functionNames(), QStringList({"main", "myFreeFunction", "myOtherFreeFunction", "freeFunction"}));
+
+        // Edits within a line
+        QVERIFY(codedocument->find("myFreeFunction"));
+        codedocument->replace(codedocument->selectionStart(), codedocument->selectionEnd(), "renamedFunction");
+        QCOMPARE(functionNames(), QStringList({"main", "renamedFunction", "myOtherFreeFunction", "freeFunction"}));
+
+        // Several edits spanning multiple lines before parsing again
+        codedocument->gotoStartOfDocument();
+        codedocument->insert("void first()\n{\n}\n\n");
+        QVERIFY(codedocument->find("int myOtherFreeFunction("));
+        codedocument->gotoStartOfLine();
+        codedocument->selectNextLine(11);
+        codedocument->deleteSelection();
+        QCOMPARE(functionNames(), QStringList({"first", "main", "renamedFunction", "freeFunction"}));
+
+        // Undo also needs to be reflected
+        codedocument->undo();
+        QCOMPARE(functionNames(),
+                 QStringList({"first", "main", "renamedFunction", "myOtherFreeFunction", "freeFunction"}));
+
+        // Non-breaking spaces are parsed as spaces, same as for a full parse
+        codedocument->gotoStartOfDocument();
+        codedocument->insert(QString("void%1spaced() {}\n").arg(QChar(QChar::Nbsp)));
+        QCOMPARE(functionNames(),
+                 QStringList({"spaced", "first", "main", "renamedFunction", "myOtherFreeFunction", "freeFunction"}));
+
+        // Replacing the whole text falls back to a full parse
+        codedocument->setText("void other() {}\n");
+        QCOMPARE(functionNames(), QStringList({"other"}));
+    }
+
+    void queryIn()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const auto functions = codedocument->query(R"EOF(
+                (function_definition
+                  declarator: (function_declarator
+                    declarator: (identifier) @name)
+                  body: (_) @body) @function
+                )EOF");
+        QCOMPARE(functions.size(), 4);
+
+        const auto returns = kdalgorithms::transformed<QStringList>(functions, [](const Core::QueryMatch &function) {
+            const auto matches = function.queryIn("body", "(return_statement (_) @value)");
+            return matches.size() == 1 ? matches.first().get("value").text() : QString();
+        });
+        QCOMPARE(returns, QStringList({"0", "\"hello\"", "42", "5"}));
+
+        // Matches that extend beyond the range are not returned
+        QVERIFY(functions.first().queryIn("body", "(function_definition) @function").isEmpty());
+        QVERIFY(functions.first().queryIn("body", "(function_definition body: (_) @body)").isEmpty());
+        QVERIFY(functions.first().queryIn("body", "(function_definition)").isEmpty());
+        QCOMPARE(functions.first().queryIn("function", "(function_definition) @function").size(), 1);
+    }
+
+    void queryIter()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        const auto query =
+            QString("(function_definition declarator: (function_declarator declarator: (_) @name)) @function");
+
+        auto iterator = codedocument->createQueryIterator(query);
+        QStringList names;
+        for (auto match = iterator->next(); !iterator->atEnd(); match = iterator->next()) {
+            names.push_back(match.get("name").text());
+        }
+        QCOMPARE(names, QStringList({"main", "myFreeFunction", "myOtherFreeFunction", "freeFunction"}));
+        QVERIFY(!iterator->isTruncated());
+
+        // maxMatches
+        iterator = codedocument->createQueryIterator(query, 1);
+        QCOMPARE(iterator->next().get("name").text(), "main");
+        QVERIFY(iterator->next().isEmpty());
+        QVERIFY(iterator->atEnd());
+        QVERIFY(iterator->isTruncated());
+
+        // Editing the document stops the iteration
+        iterator = codedocument->createQueryIterator(query);
+        QVERIFY(!iterator->next().isEmpty());
+        codedocument->insertAtPosition("// Comment\n", 0);
+        QVERIFY(iterator->next().isEmpty());
+        QVERIFY(iterator->atEnd());
+
+        // Invalid query
+        iterator = codedocument->createQueryIterator("(function_definition");
+        QVERIFY(iterator->atEnd());
+
+        // JavaScript iteration, with early termination
+        QJSEngine engine;
+        engine.globalObject().setProperty("document", engine.newQObject(codedocument));
+        auto result = engine.evaluate(QString(R"js(
+            let names = [];
+            for (const match of document.queryIter("%1")) {
+                names.push(match.get("name").text);
+                if (names.length == 2)
+                    break;
+            }
+            names.join(",");
+        )js")
+                                          .arg(query));
+        QCOMPARE(result.toString(), "main,myFreeFunction");
+
+        result = engine.evaluate(QString(R"js(
+            Array.from(document.queryIter("%1", 3)).length;
+        )js")
+                                     .arg(query));
+        QCOMPARE(result.toInt(), 3);
+    }
+
+    void queryLimits()
+    {
+        INIT_KNUT_PROJECT;
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        const auto queryString = QString("(function_definition) @function");
+        const auto query = treesitter::QueryCache::instance().query(tree_sitter_cpp(), queryString);
+        bool truncated = true;
+
+        QCOMPARE(codedocument->query(query, {}, {}, &truncated).size(), 4);
+        QVERIFY(!truncated);
+
+        QCOMPARE(codedocument->query(query, {.maxMatches = 2}, {}, &truncated).size(), 2);
+        QVERIFY(truncated);
+
+        // Not truncated if there are no more matches
+        QCOMPARE(codedocument->query(query, {.maxMatches = 4}, {}, &truncated).size(), 4);
+        QVERIFY(!truncated);
+
+        // The limits apply to all ranges together
+        const auto all = codedocument->createRangeMark(0, codedocument->text().size());
+        QCOMPARE(codedocument->queryInRanges({all, all}, queryString, {.maxMatches = 6}, {}, &truncated).size(), 6);
+        QVERIFY(truncated);
+        QCOMPARE(codedocument->queryInRanges({all, all}, queryString, {.maxMatches = 8}, {}, &truncated).size(), 8);
+        QVERIFY(!truncated);
+
+        // Queries run by scripts use the settings, unless overridden by the options
+        SET_DEFAULT_VALUE(TreeSitterQueryMaxMatches, 3);
+        QCOMPARE(codedocument->query(queryString).size(), 3);
+        QCOMPARE(codedocument->query(queryString, {{"maxMatches", 0}}).size(), 4);
+        QCOMPARE(codedocument->queryInRange(all, queryString).size(), 3);
+        QCOMPARE(codedocument->queryInRange(all, queryString, {{"maxMatches", 2}}).size(), 2);
+        QCOMPARE(codedocument->queryFirst(queryString).get("function").text(),
+                 codedocument->query(queryString).first().get("function").text());
+        SET_DEFAULT_VALUE(TreeSitterQueryMaxMatches, 0);
+    }
+
     void ast()
     {
         Test::FileTester header(Test::testDataPath() + "/tst_codedocument/ast/header.h");
@@ -453,6 +889,29 @@ private slots:
         QCOMPARE(children[0].startPos(), 38);
         QCOMPARE(children[0].endPos(), 42);
 
+        // Cursor-like navigation
+        {
+            auto child = foo.firstChild();
+            QCOMPARE(child.type(), "primitive_type");
+            QVERIFY(!child.previousSibling().isValid());
+            child = child.nextSibling();
+            QCOMPARE(child.type(), children[1].type());
+            QCOMPARE(child.previousSibling().text(), "void");
+            child = child.nextSibling();
+            QCOMPARE(child.type(), children[2].type());
+            QVERIFY(!child.nextSibling().isValid());
+
+            // Pre-order walk of the function, the last node is the closing brace
+            QList<Core::AstNode> nodes;
+            for (auto node = foo.nextNode(foo); node.isValid(); node = node.nextNode(foo)) {
+                nodes.push_back(node);
+            }
+            QVERIFY(nodes.size() > 3);
+            QCOMPARE(nodes.first().text(), "void");
+            QCOMPARE(nodes.last().text(), "}");
+            QCOMPARE(nodes.last().endPos(), foo.endPos());
+        }
+
         QVERIFY(foo.isValid());
 
         // Change text before node, position etc should adopt
@@ -13,6 +13,7 @@
 #include "core/cppdocument.h"
 #include "core/knutcore.h"
 #include "core/project.h"
+#include "treesitter/query_cache.h"
 
 #include <kdalgorithms.h>
 
@@ -350,6 +351,31 @@ private slots:
         // TODO: test parameters
     }
 
+    void queryTemplates()
+    {
+        Test::testCppDocument("tst_cppdocument/query", "myclass.h", [](Core::CppDocument *document) {
+            const QStringList methods {"foo", "setFoo", "setFooBar", "fooRef", "barPtr", "MyClass", "~MyClass"};
+
+            // Compile the templates a first time
+            QCOMPARE(document->queryMethodDeclaration("MyClass", "foo").size(), 1);
+            QVERIFY(!document->queryMember("MyClass", "m_double").isEmpty());
+
+            // Whatever the names, the queries are only compiled once
+            const auto before = treesitter::QueryCache::instance().statistics();
+            for (const auto &method : methods) {
+                QCOMPARE(document->queryMethodDeclaration("MyClass", method).size(), 1);
+            }
+            QVERIFY(!document->queryMember("MyClass", "m_constInt").isEmpty());
+            QVERIFY(!document->queryMember("MyClass", "m_fooRef").isEmpty());
+            QVERIFY(document->queryMember("MyClass", "m_doesnotexist").isEmpty());
+            const auto after = treesitter::QueryCache::instance().statistics();
+            QCOMPARE(after.misses, before.misses);
+
+            // Names are not part of the query, so they don't need escaping
+            QVERIFY(document->queryMethodDeclaration("MyClass", R"(foo" @name))").isEmpty());
+        });
+    }
+
     void changeBaseClass()
     {
         Core::KnutCore core;
@@ -391,6 +417,70 @@ private slots:
             QCOMPARE(match.get("return").text(), "void");
         });
     }
+
+private:
+    static QList<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> rangesOf(const QList<treesitter::Range> &ranges)
+    {
+        return kdalgorithms::transformed(ranges, [](const treesitter::Range &range) {
+            return std::make_tuple(range.start_byte, range.end_byte, range.start_point.row, range.end_point.row);
+        });
+    }
+
+    // Included ranges computed from scratch, on a new document with the same text.
+    static QList<treesitter::Range> freshIncludedRanges(const QString &text)
+    {
+        Core::CppDocument document;
+        document.setText(text);
+        return document.includedRanges();
+    }
+
+private slots:
+    void excludeMacrosAfterEdit()
+    {
+        Test::testCppDocument("tst_cppdocument/treesitterExcludesMacros", "AFX_EXT_CLASS.h", [](auto *document) {
+            QCOMPARE(document->includedRanges().size(), 6);
+
+            // The excluded macros are only scanned again in the edited lines.
+            document->insertAtPosition("AFX_EXT_CLASS ", 0);
+            QCOMPARE(rangesOf(document->includedRanges()), rangesOf(freshIncludedRanges(document->text())));
+
+            document->insertAtPosition("\nint MY_EXPORT_API value;\nint AFX_EXT_CLASS other;", 40);
+            QCOMPARE(rangesOf(document->includedRanges()), rangesOf(freshIncludedRanges(document->text())));
+
+            document->deleteRegion(20, 60);
+            QCOMPARE(rangesOf(document->includedRanges()), rangesOf(freshIncludedRanges(document->text())));
+
+            document->replaceAll("AFX_EXT_CLASS", "AFX");
+            QCOMPARE(rangesOf(document->includedRanges()), rangesOf(freshIncludedRanges(document->text())));
+        });
+    }
+
+    void benchmarkExcludeMacros()
+    {
+        Test::testCppDocument("tst_cppdocument/treesitterExcludesMacros", "AFX_EXT_CLASS.h", [](auto *document) {
+            // A large MFC header, with excluded macros on most lines.
+            QString text;
+            for (int i = 0; i < 1000; ++i) {
+                text += QString("class AFX_EXT_CLASS CMyClass%1 : public CObject\n"
+                                "{\n"
+                                "public:\n"
+                                "    AFX_EXT_CLASS CMyClass%1();\n"
+                                "    AFX_EXT_CLASS void DoSomething(int AFX_EXT_CLASS value);\n"
+                                "    MY_EXPORT_API int m_count;\n"
+                                "};\n\n")
+                            .arg(i);
+            }
+            document->setText(text);
+            QCOMPARE(document->includedRanges().size(), 5 * 1000 + 1);
+
+            const auto position = text.size() / 2;
+            QBENCHMARK {
+                document->insertAtPosition("AFX_EXT_CLASS ", position);
+                document->deleteRegion(position, position + 14);
+                QVERIFY(!document->queryClassDefinition("CMyClass500").isEmpty());
+            }
+        });
+    }
 };
 
 QTEST_MAIN(TestCppDocumentTreeSitter)
@@ -0,0 +1,96 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/test_utils.h"
+#include "core/file.h"
+#include "core/knutcore.h"
+#include "core/project.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestProject : public QObject
+{
+    Q_OBJECT
+
+    static void createFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void allFiles()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        QCOMPARE(project->allFiles(), QStringList({"CMakeLists.txt", "main.cpp", "myobject.cpp", "myobject.h"}));
+        QCOMPARE(project->allFiles(Core::Project::FullPath).first(), project->root() + "/CMakeLists.txt");
+        QCOMPARE(project->allFilesWithExtension("cpp"), QStringList({"main.cpp", "myobject.cpp"}));
+        QCOMPARE(project->allFilesWithExtension("CPP"), QStringList());
+        QCOMPARE(project->allFilesWithExtensions({"H", "cpp"}), QStringList({"main.cpp", "myobject.cpp", "myobject.h"}));
+        QCOMPARE(project->allFilesWithName("MyObject.h"), QStringList({"myobject.h"}));
+    }
+
+    void updateFiles()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(QDir(dir.path()).mkpath("src/.hidden"));
+        createFile(dir.path() + "/src/main.cpp");
+        createFile(dir.path() + "/src/.hidden/hidden.cpp");
+        createFile(dir.path() + "/.hidden.cpp");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        // Hidden files and directories are ignored by default
+        QCOMPARE(project->allFiles(), QStringList({"src/main.cpp"}));
+
+        // Changes made by Knut are visible right away
+        QVERIFY(Core::File::copy(dir.path() + "/src/main.cpp", dir.path() + "/src/other.cpp"));
+        QCOMPARE(project->allFiles(), QStringList({"src/main.cpp", "src/other.cpp"}));
+        QVERIFY(Core::File::remove(dir.path() + "/src/main.cpp"));
+        QCOMPARE(project->allFiles(), QStringList({"src/other.cpp"}));
+
+        // Other changes once notified by the file system watcher, including new directories
+        QVERIFY(QDir(dir.path()).mkpath("include/sub"));
+        createFile(dir.path() + "/include/sub/other.h");
+        QTRY_COMPARE(project->allFilesWithName("other.h"), QStringList({"include/sub/other.h"}));
+        QVERIFY(QDir(dir.path() + "/include").removeRecursively());
+        QTRY_COMPARE(project->allFiles(), QStringList({"src/other.cpp"}));
+    }
+
+    void updateFilesDuringScan()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(QDir(dir.path()).mkpath("src"));
+        createFile(dir.path() + "/src/main.cpp");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        // Whether the directory is listed before or after the change, the change is seen without the watcher
+        createFile(dir.path() + "/src/other.cpp");
+        QCOMPARE(project->allFiles(), QStringList({"src/main.cpp", "src/other.cpp"}));
+    }
+};
+
+QTEST_MAIN(TestProject)
+#include "tst_project.moc"
@@ -181,6 +181,13 @@ private slots:
         typedsymbol = qobject_cast<Core::TypedSymbol *>(members.last());
         QVERIFY(typedsymbol);
         QCOMPARE(typedsymbol->type(), "MyEnum");
+
+        // The members belong to the symbol table of the document, they are found again once it's outdated.
+        codeDocument->insertAtPosition("// Hello\n", 0);
+        const auto newMembers = symbolClass->members();
+        QCOMPARE(newMembers.size(), 10);
+        QCOMPARE(newMembers.first()->name(), "MyObject::MyObject");
+        QVERIFY(newMembers.first()->parent() == codeDocument);
     }
 
     void references()
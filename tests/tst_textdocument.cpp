@@ -15,8 +15,12 @@
 #include "core/textdocument.h"
 #include "core/utils.h"
 
+#include <QApplication>
 #include <QDir>
 #include <QFile>
+#include <QJSEngine>
+#include <QPlainTextEdit>
+#include <QSignalSpy>
 #include <QTest>
 #include <QTextStream>
 
@@ -207,6 +211,34 @@ private slots:
         QCOMPARE(document.column(), 10);
     }
 
+    void view()
+    {
+        Core::TextDocument document;
+        document.load(Test::testDataPath() + "/tst_textdocument/loremipsum_lf_utf8.txt");
+
+        // The document can be used without any view
+        const auto widgetCount = QApplication::allWidgets().size();
+        QSignalSpy positionSpy(&document, &Core::TextDocument::positionChanged);
+        QSignalSpy selectionSpy(&document, &Core::TextDocument::selectionChanged);
+        document.selectRegion(240, 246);
+        QCOMPARE(document.selectedText(), "sapien");
+        QCOMPARE(positionSpy.count(), 1);
+        QCOMPARE(selectionSpy.count(), 1);
+        document.insert("foo");
+        QCOMPARE(document.currentLine(), "In venenatis foo eu ornare sollicitudin.");
+        document.undo();
+        QCOMPARE(document.currentLine(), "In venenatis sapien eu ornare sollicitudin.");
+        QCOMPARE(QApplication::allWidgets().size(), widgetCount);
+
+        // The view is created on demand, sharing the text and the cursor of the document
+        document.gotoLine(8, 15);
+        auto textEdit = document.textEdit();
+        QCOMPARE(textEdit->document(), document.qTextDocument());
+        QCOMPARE(textEdit->textCursor().position(), 241);
+        textEdit->moveCursor(QTextCursor::EndOfWord);
+        QCOMPARE(document.position(), 246);
+    }
+
     void edition()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/edition/loremipsum.txt");
@@ -357,6 +389,193 @@ private slots:
         QVERIFY(mark == 10);
     }
 
+    void manyMarks()
+    {
+        // Positions updated with Mark::updateMark, to compare with the marks.
+        QList<int> positions;
+        Core::TextDocument document;
+        document.setText(QString("0123456789").repeated(1000));
+
+        // Enough marks to have both sorted and pending ones in the mark table.
+        QList<Core::Mark> marks;
+        for (int i = 0; i < 5000; ++i) {
+            marks.push_back(document.createMark((i * 7) % 10000));
+            positions.push_back(marks.last().position());
+        }
+        auto rangeMark = document.createRangeMark(100, 200);
+
+        connect(document.textEdit()->document(), &QTextDocument::contentsChange, this,
+                [&positions](int from, int charsRemoved, int charsAdded) {
+                    for (auto &position : positions)
+                        Core::Mark::updateMark(position, from, charsRemoved, charsAdded);
+                });
+        auto verifyMarks = [&]() {
+            for (int i = 0; i < marks.size(); ++i)
+                QCOMPARE(marks.at(i).position(), positions.at(i));
+        };
+
+        document.insertAtPosition("Hello", 50);
+        verifyMarks();
+        document.deleteRegion(1000, 2000);
+        verifyMarks();
+        document.replace(10, 20, "World");
+        verifyMarks();
+        QCOMPARE(rangeMark.start(), 100);
+        QCOMPARE(rangeMark.end(), 200);
+
+        // Released marks are dropped from the table.
+        marks.remove(0, 4000);
+        positions.remove(0, 4000);
+        document.insertAtPosition("Hello", 0);
+        verifyMarks();
+        document.deleteRegion(0, 5000);
+        verifyMarks();
+        QCOMPARE(rangeMark.start(), 0);
+        QCOMPARE(rangeMark.end(), 0);
+    }
+
+    void benchmarkCreateMarks()
+    {
+        Core::TextDocument document;
+        document.setText(QString("0123456789").repeated(10000));
+
+        QBENCHMARK {
+            QList<Core::RangeMark> marks;
+            for (int i = 0; i < 50000; ++i)
+                marks.push_back(document.createRangeMark(i, i + 10));
+        }
+    }
+
+    void benchmarkEditWithMarks()
+    {
+        Core::TextDocument document;
+        document.setText(QString("0123456789").repeated(10000));
+
+        // 100k marks
+        QList<Core::RangeMark> marks;
+        for (int i = 0; i < 50000; ++i)
+            marks.push_back(document.createRangeMark(i, i + 10));
+
+        QBENCHMARK {
+            document.insertAtPosition(" ", 50000);
+            document.deleteRegion(50000, 50001);
+        }
+        QCOMPARE(marks.last().start(), 49999);
+    }
+
+    void replaceAllMarks()
+    {
+        Core::TextDocument document;
+        document.setText(QString("foo bar baz\n").repeated(100));
+
+        // On each line, marks before, inside and after "bar"
+        QList<Core::Mark> marks;
+        for (int i = 0; i < 100; ++i) {
+            marks.push_back(document.createMark(i * 12 + 4));
+            marks.push_back(document.createMark(i * 12 + 5));
+            marks.push_back(document.createMark(i * 12 + 7));
+        }
+        auto rangeMark = document.createRangeMark(4, 7);
+
+        // All replacements are done in a single edit
+        QSignalSpy spy(document.textEdit()->document(), &QTextDocument::contentsChange);
+        QCOMPARE(document.replaceAll("bar", "hello"), 100);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(document.text(), QString("foo hello baz\n").repeated(100));
+
+        // The marks are updated as if each occurrence was replaced separately
+        for (int i = 0; i < 100; ++i) {
+            QCOMPARE(marks.at(i * 3).position(), i * 14 + 4);
+            QCOMPARE(marks.at(i * 3 + 1).position(), i * 14 + 4);
+            QCOMPARE(marks.at(i * 3 + 2).position(), i * 14 + 9);
+        }
+        QCOMPARE(rangeMark.start(), 4);
+        QCOMPARE(rangeMark.end(), 9);
+        QCOMPARE(rangeMark.text(), "hello");
+
+        // Only the matches inside the range are replaced
+        QCOMPARE(document.replaceAllInRange("o", "0", document.createRangeMark(14, 28)), 3);
+        QCOMPARE(document.text().sliced(0, 42), "foo hello baz\nf00 hell0 baz\nfoo hello baz\n");
+    }
+
+    void benchmarkReplaceAll()
+    {
+        Core::TextDocument document;
+        // 200k occurrences
+        document.setText(QString("int oldName = oldName + 1;\n").repeated(100000));
+        QList<Core::Mark> marks;
+        for (int i = 0; i < 1000; ++i)
+            marks.push_back(document.createMark(i * 270));
+
+        QBENCHMARK {
+            QCOMPARE(document.replaceAll("oldName", "newName", Core::TextDocument::FindWholeWords), 200000);
+            QCOMPARE(document.replaceAll("newName", "oldName", Core::TextDocument::FindWholeWords), 200000);
+        }
+        QCOMPARE(marks.last().position(), 999 * 270);
+    }
+
+    void batch()
+    {
+        Core::TextDocument document;
+        document.setText("foo\nbar\nbaz\n");
+        auto mark = document.createMark(8);
+
+        QSignalSpy spy(&document, &Core::TextDocument::textChanged);
+        document.beginBatch();
+        document.insertAtLine("// ", 1);
+        document.beginBatch();
+        document.insertAtLine("// ", 2);
+        document.endBatch();
+        document.deleteLine(3);
+        // Everything is up to date during the batch, only the notification is deferred
+        QCOMPARE(document.text(), "// foo\n// bar\n");
+        QCOMPARE(mark.position(), 14);
+        QCOMPARE(spy.count(), 0);
+        document.endBatch();
+        QCOMPARE(spy.count(), 1);
+
+        // Not in a batch anymore
+        document.endBatch();
+        document.insert("qux");
+        QCOMPARE(spy.count(), 2);
+
+        // Batches left running, e.g. by a script stopped by an exception
+        document.beginBatch();
+        document.beginBatch();
+        document.insert("quux");
+        document.endBatches();
+        QCOMPARE(spy.count(), 3);
+    }
+
+    void applyEdits()
+    {
+        Core::TextDocument document;
+        document.setText("foo\nbar\n");
+
+        QJSEngine engine;
+        QJSEngine::setObjectOwnership(&document, QJSEngine::CppOwnership);
+        engine.globalObject().setProperty("document", engine.newQObject(&document));
+
+        QSignalSpy spy(&document, &Core::TextDocument::textChanged);
+        auto result = engine.evaluate(R"(document.applyEdits(() => {
+            document.insertAtLine("// ", 1)
+            document.insertAtLine("// ", 2)
+        }))");
+        QVERIFY(!result.isError());
+        QCOMPARE(document.text(), "// foo\n// bar\n");
+        QCOMPARE(spy.count(), 1);
+
+        // The batch is ended, and the exception thrown again
+        result = engine.evaluate(R"(document.applyEdits(() => {
+            document.insertAtLine("// ", 1)
+            throw new Error("Stopped")
+        }))");
+        QVERIFY(result.isError());
+        QCOMPARE(spy.count(), 2);
+        document.insert("qux");
+        QCOMPARE(spy.count(), 3);
+    }
+
     void indent()
     {
         auto spaces = [](int count) {
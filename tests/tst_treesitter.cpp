@@ -13,9 +13,12 @@
 #include "treesitter/parser.h"
 #include "treesitter/predicates.h"
 #include "treesitter/query.h"
+#include "treesitter/query_cache.h"
 #include "treesitter/tree.h"
+#include "treesitter/tree_cursor.h"
 
 #include <QTest>
+#include <functional>
 
 class TestTreeSitter : public QObject
 {
@@ -221,10 +224,61 @@ private slots:
         auto captures = firstMatch->capturesNamed("name");
         QCOMPARE(captures.size(), 1);
         QCOMPARE(captures.first().node.textIn(source), "main");
+        QVERIFY(captures.first().node.textViewIn(source) == u"main");
 
         QVERIFY(!cursor.nextMatch().has_value());
     }
 
+    void eq_predicate_parameters()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+            (function_definition
+                (function_declarator
+                    declarator: (_) @name
+                    (#eq? @name "$functionName")
+                    ))
+        )EOF");
+
+        treesitter::QueryCursor cursor;
+        cursor.execute(query, tree->rootNode(),
+                       std::make_unique<treesitter::Predicates>(source, treesitter::Predicates::Parameters {
+                                                                            {"functionName", "main"}}));
+        auto match = cursor.nextMatch();
+        QVERIFY(match.has_value());
+        QCOMPARE(match->capturesNamed("name").first().node.textIn(source), "main");
+        QVERIFY(!cursor.nextMatch().has_value());
+
+        // Same query, another parameter value
+        cursor.execute(query, tree->rootNode(),
+                       std::make_unique<treesitter::Predicates>(source, treesitter::Predicates::Parameters {
+                                                                            {"functionName", "doesNotExist"}}));
+        QVERIFY(!cursor.nextMatch().has_value());
+
+        // Without parameters, the string is compared as is
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QVERIFY(!cursor.nextMatch().has_value());
+
+        // Parameters are also bound in commands
+        auto excludeQuery = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+            (function_definition
+                body: (_) @body
+                (#exclude! @body "$excludedType"))
+        )EOF");
+        cursor.execute(excludeQuery, tree->rootNode(),
+                       std::make_unique<treesitter::Predicates>(source, treesitter::Predicates::Parameters {
+                                                                            {"excludedType", "compound_statement"}}));
+        match = cursor.nextMatch();
+        QVERIFY(match.has_value());
+        QVERIFY(match->capturesNamed("body").isEmpty());
+        cursor.execute(excludeQuery, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        match = cursor.nextMatch();
+        QVERIFY(match.has_value());
+        QCOMPARE(match->capturesNamed("body").size(), 1);
+    }
+
     void match_predicate_errors()
     {
         using Error = treesitter::Query::Error;
@@ -266,6 +320,19 @@ private slots:
         QVERIFY(!cursor.nextMatch().has_value());
     }
 
+    void match_predicate_precompiled()
+    {
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+            ((identifier) @name (#match? "^my" @name))
+            ((identifier) @name (#match? "Function$" @name))
+        )EOF");
+
+        QCOMPARE(query->patterns().size(), 2);
+        QCOMPARE(query->regularExpression("^my").pattern(), "^my");
+        QVERIFY(query->regularExpression("^my").isValid());
+        QVERIFY(query->regularExpression("Function$").match("freeFunction").hasMatch());
+    }
+
     void in_message_map_predicate_errors()
     {
         using Error = treesitter::Query::Error;
@@ -464,6 +531,342 @@ private slots:
         auto matches = cursor.allRemainingMatches();
         QCOMPARE(matches.size(), 1); // Only one function that returns a string, and not an int.
     }
+
+    void queryLimits()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), "(function_definition) @function");
+
+        treesitter::QueryCursor cursor;
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        const auto count = cursor.allRemainingMatches().size();
+        QVERIFY(count > 1);
+        QVERIFY(cursor.truncation() == treesitter::QueryCursor::Truncation::None);
+
+        cursor.setLimits({.maxMatches = 1});
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QCOMPARE(cursor.allRemainingMatches().size(), 1);
+        QVERIFY(cursor.truncation() == treesitter::QueryCursor::Truncation::MaxMatches);
+
+        cursor.setLimits({.maxMatches = static_cast<int>(count)});
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QCOMPARE(cursor.allRemainingMatches().size(), count);
+        QVERIFY(cursor.truncation() == treesitter::QueryCursor::Truncation::None);
+    }
+
+    void queryCursorReuse()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), "(function_definition) @function");
+
+        qsizetype count = 0;
+        {
+            treesitter::QueryCursor cursor;
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            count = cursor.allRemainingMatches().size();
+        }
+        {
+            treesitter::QueryCursor cursor;
+            cursor.setRange(0, 1);
+            cursor.setLimits({.matchLimit = 1});
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            QVERIFY(cursor.allRemainingMatches().size() < count);
+        }
+
+        // Cursors are reused, make sure the range and limits of the previous cursor are gone.
+        for (int i = 0; i < 10; ++i) {
+            treesitter::QueryCursor cursor;
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            QCOMPARE(cursor.allRemainingMatches().size(), count);
+        }
+    }
+
+    void pooledParser()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        qsizetype count = 0;
+        {
+            treesitter::PooledParser parser(Core::Document::Type::Cpp);
+            auto tree = parser->parseString(source);
+            QVERIFY(tree.has_value());
+            count = tree->rootNode().namedChildren().size();
+        }
+        {
+            // Borrowing a parser while another one is borrowed creates a new one.
+            treesitter::PooledParser parser(Core::Document::Type::Cpp);
+            treesitter::PooledParser other(Core::Document::Type::Cpp);
+            QVERIFY(&*parser != &*other);
+            // Only parse the first line, the first include (positions are in bytes, the text is in UTF-16).
+            QVERIFY(parser->setIncludedRanges({{{0, 0}, {0, 38}, 0, 38}}));
+            auto tree = parser->parseString(source);
+            QVERIFY(tree.has_value());
+            QVERIFY(tree->rootNode().namedChildren().size() < count);
+        }
+
+        // Parsers are reused, make sure the included ranges of the previous parse are gone.
+        treesitter::PooledParser parser(Core::Document::Type::Cpp);
+        auto tree = parser->parseString(source);
+        QVERIFY(tree.has_value());
+        QCOMPARE(tree->rootNode().namedChildren().size(), count);
+        QCOMPARE(parser->language(), tree_sitter_cpp());
+    }
+
+    void benchmarkManyQueries()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), "(function_definition) @function");
+
+        QBENCHMARK {
+            for (int i = 0; i < 100; ++i) {
+                treesitter::QueryCursor cursor;
+                cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+                QVERIFY(cursor.nextMatch().has_value());
+            }
+        }
+    }
+
+    void queryCache()
+    {
+        treesitter::QueryCache cache(2);
+
+        auto first = cache.query(tree_sitter_cpp(), "(function_definition) @function");
+        QVERIFY(first);
+        QCOMPARE(cache.statistics().misses, 1);
+        QCOMPARE(cache.statistics().hits, 0);
+
+        // The same query for the same language is shared
+        QCOMPARE(cache.query(tree_sitter_cpp(), "(function_definition) @function"), first);
+        QCOMPARE(cache.statistics().hits, 1);
+
+        // ... but not for another language
+        auto qml = cache.query(tree_sitter_qmljs(), "(comment) @comment");
+        auto cpp = cache.query(tree_sitter_cpp(), "(comment) @comment");
+        QVERIFY(qml != cpp);
+        QCOMPARE(cache.statistics().misses, 3);
+        QCOMPARE(cache.statistics().size, 2);
+
+        // The least recently used query was evicted
+        QVERIFY(cache.query(tree_sitter_cpp(), "(function_definition) @function") != first);
+        QCOMPARE(cache.statistics().misses, 4);
+        QCOMPARE(cache.statistics().size, 2);
+
+        // Invalid queries still throw, and aren't cached
+        using Error = treesitter::Query::Error;
+        QVERIFY_THROWS_EXCEPTION(Error, cache.query(tree_sitter_cpp(), "(field_expr)"));
+        QCOMPARE(cache.statistics().size, 2);
+    }
+
+    void incrementalParsing()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        // Rename "main" to "notMain"
+        const auto position = static_cast<uint32_t>(source.indexOf("main"));
+        source.insert(position, "not");
+        const auto row = static_cast<uint32_t>(QStringView(source).first(position).count(u'\n'));
+        const auto column = static_cast<uint32_t>(position - source.lastIndexOf('\n', position) - 1);
+        tree->edit({.start_byte = static_cast<uint32_t>(position * sizeof(QChar)),
+                    .old_end_byte = static_cast<uint32_t>(position * sizeof(QChar)),
+                    .new_end_byte = static_cast<uint32_t>((position + 3) * sizeof(QChar)),
+                    .start_point = {row, static_cast<uint32_t>(column * sizeof(QChar))},
+                    .old_end_point = {row, static_cast<uint32_t>(column * sizeof(QChar))},
+                    .new_end_point = {row, static_cast<uint32_t>((column + 3) * sizeof(QChar))}});
+        auto newTree = parser.parseString(source, &tree.value());
+        QVERIFY(newTree.has_value());
+        QVERIFY(!newTree->rootNode().hasError());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+            (function_definition
+                (function_declarator
+                    declarator: (_) @name
+                    (#eq? "notMain" @name)))
+        )EOF");
+
+        treesitter::QueryCursor cursor;
+        cursor.execute(query, newTree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+
+        auto matches = cursor.allRemainingMatches();
+        QCOMPARE(matches.size(), 1);
+        QCOMPARE(matches.first().capturesNamed("name").first().node.textIn(source), "notMain");
+    }
+
+    void nodeRange()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        const auto root = tree->rootNode();
+
+        QList<treesitter::Node> nodes;
+        for (const auto &node : treesitter::NodeRange::children(root)) {
+            nodes.push_back(node);
+        }
+        QCOMPARE(nodes, root.children());
+
+        nodes.clear();
+        for (const auto &node : treesitter::NodeRange::namedChildren(root)) {
+            nodes.push_back(node);
+        }
+        QCOMPARE(nodes.size(), 9);
+        QCOMPARE(nodes, root.namedChildren());
+
+        // Pre-order, same as walking the children recursively
+        std::function<void(const treesitter::Node &, QList<treesitter::Node> &)> addDescendants =
+            [&addDescendants](const treesitter::Node &node, QList<treesitter::Node> &result) {
+                for (const auto &child : node.children()) {
+                    result.push_back(child);
+                    addDescendants(child, result);
+                }
+            };
+        QList<treesitter::Node> expected;
+        addDescendants(root, expected);
+        nodes.clear();
+        for (const auto &node : treesitter::NodeRange::descendants(root)) {
+            nodes.push_back(node);
+        }
+        QCOMPARE(nodes, expected);
+
+        // Only the descendants of the given node are visited
+        const auto function = root.namedChildren().at(3);
+        QCOMPARE(function.type(), "function_definition");
+        expected.clear();
+        addDescendants(function, expected);
+        nodes.clear();
+        for (const auto &node : treesitter::NodeRange::descendants(function)) {
+            nodes.push_back(node);
+        }
+        QCOMPARE(nodes, expected);
+
+        // Skipping the children of the function definitions
+        nodes.clear();
+        auto descendants = treesitter::NodeRange::descendants(root);
+        for (auto it = descendants.begin(); it != descendants.end(); ++it) {
+            const auto node = *it;
+            if (node.type() == "function_definition") {
+                nodes.push_back(node);
+                descendants.skipChildren();
+            }
+        }
+        QCOMPARE(nodes.size(), 4);
+        QVERIFY(nodes.contains(function));
+
+        // Leaf nodes have no children
+        const auto leaf = expected.constLast();
+        QCOMPARE(leaf.childCount(), 0);
+        auto leafChildren = treesitter::NodeRange::children(leaf);
+        QVERIFY(leafChildren.begin() == leafChildren.end());
+        auto leafDescendants = treesitter::NodeRange::descendants(leaf);
+        QVERIFY(leafDescendants.begin() == leafDescendants.end());
+    }
+
+    void benchmarkWalkTree_data()
+    {
+        QTest::addColumn<bool>("cursor");
+
+        QTest::newRow("lists") << false;
+        QTest::newRow("cursor") << true;
+    }
+
+    void benchmarkWalkTree()
+    {
+        QFETCH(bool, cursor);
+
+        // ~20k lines of MFC code
+        auto source = readTestFile("/tst_treesitter/mfc-TutorialDlg.cpp").repeated(150);
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        std::function<int(const treesitter::Node &)> countWithLists = [&countWithLists](const treesitter::Node &node) {
+            int count = 0;
+            for (const auto &child : node.children()) {
+                count += 1 + countWithLists(child);
+            }
+            return count;
+        };
+
+        int count = 0;
+        QBENCHMARK {
+            count = 0;
+            if (cursor) {
+                for (const auto &node : treesitter::NodeRange::descendants(tree->rootNode())) {
+                    Q_UNUSED(node)
+                    ++count;
+                }
+            } else {
+                count = countWithLists(tree->rootNode());
+            }
+        }
+        QVERIFY(count > 20000);
+    }
+
+    void benchmarkEditThenQuery_data()
+    {
+        QTest::addColumn<bool>("incremental");
+
+        QTest::newRow("full") << false;
+        QTest::newRow("incremental") << true;
+    }
+
+    void benchmarkEditThenQuery()
+    {
+        QFETCH(bool, incremental);
+
+        // ~20k lines of MFC code
+        auto source = readTestFile("/tst_treesitter/mfc-TutorialDlg.cpp").repeated(150);
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+            (function_definition
+                declarator: (function_declarator
+                    declarator: (_) @name
+                    (#eq? @name "CTutorialDlg::OnPaint")))
+        )EOF");
+
+        // Type a space at the start of a line in the middle of the document.
+        const auto position = static_cast<uint32_t>(source.indexOf('\n', source.size() / 2) + 1);
+        const auto row = static_cast<uint32_t>(QStringView(source).first(position).count(u'\n'));
+        const treesitter::InputEdit edit {.start_byte = static_cast<uint32_t>(position * sizeof(QChar)),
+                                          .old_end_byte = static_cast<uint32_t>(position * sizeof(QChar)),
+                                          .new_end_byte = static_cast<uint32_t>((position + 1) * sizeof(QChar)),
+                                          .start_point = {row, 0},
+                                          .old_end_point = {row, 0},
+                                          .new_end_point = {row, sizeof(QChar)}};
+
+        QBENCHMARK {
+            source.insert(position, ' ');
+            if (incremental) {
+                tree->edit(edit);
+                tree = parser.parseString(source, &tree.value());
+            } else {
+                tree = parser.parseString(source);
+            }
+            QVERIFY(tree.has_value());
+
+            treesitter::QueryCursor cursor;
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            QCOMPARE(cursor.allRemainingMatches().size(), 150);
+        }
+    }
 };
 
 QTEST_MAIN(TestTreeSitter)